@@ -110,12 +110,13 @@ settings.cc.includes:Add("include")
 if family ~= "windows" then
     settings.cc.flags:Add( "-Wconversion", "-Wextra", "-Wall", "-Werror", "-Wstrict-aliasing=2" )
     settings.link.libs:Add("rt")
+    settings.link.libs:Add("pthread")
 else
     settings.link.flags:Add( "/NODEFAULTLIB:LIBCMT.LIB" );
     settings.cc.defines:Add("_ITERATOR_DEBUG_LEVEL=0")
 end
 
-local objs      = Compile( settings, 'src/profsy.cpp' )
+local objs      = Compile( settings, 'src/profsy.cpp', 'src/profsy_util.cpp' )
 local lib       = StaticLibrary( settings, 'profsy', objs )
 local test_objs = Compile( settings, 'test/profsy_tests.cpp' )
 local tests     = Link( settings, 'profsy_tests', test_objs, lib )
@@ -35,10 +35,103 @@
 	#define PROFSY_CUSTOM_TICK_FUNC profsy_get_tick
 #endif
 
+/**
+ * number of unique scope-names that can be accounted for, per thread, after the entry-budget
+ * is exhausted. scopes entered after the name-table is full will only be registered in the
+ * "overflow"-scope.
+ */
+#if !defined( PROFSY_OVERFLOW_NAMES_MAX )
+	#define PROFSY_OVERFLOW_NAMES_MAX 32
+#endif
+
+/**
+ * maximum amount of counters and gauges that can be registered to profsy.
+ */
+#if !defined( PROFSY_COUNTERS_MAX )
+	#define PROFSY_COUNTERS_MAX 64
+#endif
+
+/**
+ * maximum amount of async spans that can be in flight at the same time and the maximum amount
+ * of unique span-names that statistics are kept for.
+ */
+#if !defined( PROFSY_SPANS_MAX )
+	#define PROFSY_SPANS_MAX 256
+#endif
+
+#if !defined( PROFSY_SPAN_NAMES_MAX )
+	#define PROFSY_SPAN_NAMES_MAX 64
+#endif
+
+/**
+ * maximum amount of frame-domains, including the default domain 0 that is swapped by profsy_swap_frame().
+ */
+#if !defined( PROFSY_FRAME_DOMAINS_MAX )
+	#define PROFSY_FRAME_DOMAINS_MAX 8
+#endif
+
+/**
+ * maximum amount of performance-counters, i.e. perf_event on linux, that is read per scope in threads that has
+ * enabled them with profsy_perf_counters_enable().
+ */
+#if !defined( PROFSY_PERF_COUNTERS_MAX )
+	#define PROFSY_PERF_COUNTERS_MAX 3
+#endif
+
+/**
+ * size of the per-thread ring-buffer that samples are written to by the sampling-signal, samples that do not fit
+ * between two swaps are dropped. Needs to be a power of 2.
+ */
+#if !defined( PROFSY_SAMPLES_MAX )
+	#define PROFSY_SAMPLES_MAX 256
+#endif
+
+/**
+ * depth of the per-thread stack of scope-enters that are held back from the trace while a minimum duration is set,
+ * see profsy_set_trace_min_duration(). Scopes nested deeper than this are traced regardless of duration.
+ */
+#if !defined( PROFSY_TRACE_PENDING_MAX )
+	#define PROFSY_TRACE_PENDING_MAX 32
+#endif
+
+/**
+ * maximum amount of scopes that can be included in or excluded from the trace, see profsy_trace_filter_scope().
+ */
+#if !defined( PROFSY_TRACE_FILTER_SCOPES_MAX )
+	#define PROFSY_TRACE_FILTER_SCOPES_MAX 16
+#endif
+
 static const uint16_t PROFSY_TRACE_EVENT_ENTER    = 0;
 static const uint16_t PROFSY_TRACE_EVENT_LEAVE    = 1;
 static const uint16_t PROFSY_TRACE_EVENT_END      = 2;
 static const uint16_t PROFSY_TRACE_EVENT_OVERFLOW = 3;
+static const uint16_t PROFSY_TRACE_EVENT_COUNTER  = 4; //< value of a counter at end of frame, scope is counter-id and value is stored in following ARG-event.
+static const uint16_t PROFSY_TRACE_EVENT_ARG      = 5; //< argument to the previous event, scope is index of argument and value is stored in arg.
+static const uint16_t PROFSY_TRACE_EVENT_INSTANT  = 6; //< instant event, name is stored in following ARG-event with index PROFSY_TRACE_ARG_NAME.
+
+static const uint16_t PROFSY_TRACE_EVENT_FLOW_BEGIN = 7; //< start of a flow, i.e. a job being scheduled. flow-id is stored in following ARG-event with index 0 and name with index PROFSY_TRACE_ARG_NAME.
+static const uint16_t PROFSY_TRACE_EVENT_FLOW_STEP  = 8; //< flow passing through a thread, i.e. a job being picked up by a worker. same args as PROFSY_TRACE_EVENT_FLOW_BEGIN.
+static const uint16_t PROFSY_TRACE_EVENT_FLOW_END   = 9; //< end of a flow, i.e. a job being finished. same args as PROFSY_TRACE_EVENT_FLOW_BEGIN.
+
+static const uint16_t PROFSY_TRACE_EVENT_SPAN_BEGIN = 10; //< start of an async span. span-handle is stored in following ARG-event with index 0 and name with index PROFSY_TRACE_ARG_NAME.
+static const uint16_t PROFSY_TRACE_EVENT_SPAN_END   = 11; //< end of an async span. same args as PROFSY_TRACE_EVENT_SPAN_BEGIN.
+
+static const uint16_t PROFSY_TRACE_ARG_NAME = 0xFFFF; //< arg-index of an ARG-event holding a const char* to the name of the previous event.
+static const uint16_t PROFSY_TRACE_ARG_CPU  = 0xFFFE; //< arg-index of an ARG-event to a LEAVE-event holding the cpu that the scope was left on if it was preempted.
+static const uint16_t PROFSY_TRACE_ARG_CONTEXT_SWITCHES = 0xFFFD; //< arg-index of an ARG-event to a LEAVE-event holding the number of context-switches in a preempted scope.
+
+static const uint16_t PROFSY_SCOPE_MODE_FULL       = 0; //< scope is timed and traced.
+static const uint16_t PROFSY_SCOPE_MODE_COUNT_ONLY = 1; //< only calls to scope is counted, see profsy_set_overhead_budget().
+static const uint16_t PROFSY_SCOPE_MODE_OFF        = 2; //< nothing is recorded for scope, see profsy_set_overhead_budget().
+
+static const uint32_t PROFSY_CATEGORY_DEFAULT = 1u << 0;    //< category of scopes that are not given a category, other bits are free to use by the application.
+static const uint32_t PROFSY_CATEGORY_ALL     = 0xFFFFFFFF;
+
+static const uint32_t PROFSY_SCOPE_FLAG_SCHED_INFO        = 1 << 0; //< record cpu and context-switches at enter/leave of scope, see profsy_set_scope_flags().
+static const uint32_t PROFSY_SCOPE_FLAG_COLLAPSE_RECURSION = 1 << 1; //< re-entering scope directly under itself reuses the scope, see profsy_set_scope_flags().
+
+static const uint16_t PROFSY_COUNTER_TYPE_COUNTER = 0; //< values added to counter is summed up over a frame and reset in profsy_swap_frame()
+static const uint16_t PROFSY_COUNTER_TYPE_GAUGE   = 1; //< the last value set to gauge is reported and kept over frames
 
 /**
  * parameters for initializing profsy
@@ -54,10 +147,14 @@ struct profsy_init_params
  */
 struct profsy_trace_entry
 {
-	uint64_t ts;     //< timestamp when event occurred.
+	union
+	{
+		uint64_t ts;  //< timestamp when event occurred.
+		uint64_t arg; //< value of argument for PROFSY_TRACE_EVENT_ARG.
+	};
 	uint16_t thread; //< id of thread that event occurred on.
 	uint16_t event;  //< event that occurred.
-	uint16_t scope;  //< the scope that was involved in the event.
+	uint32_t scope;  //< the scope that was involved in the event, index of argument for PROFSY_TRACE_EVENT_ARG.
 };
 
 /**
@@ -65,6 +162,19 @@ struct profsy_trace_entry
  */
 typedef struct profsy_ctx* profsy_ctx_t;
 
+/**
+ * static descriptor of a scope call-site, created by PROFSY_SCOPE() and friends.
+ */
+struct profsy_scope_desc
+{
+	const char* name;      //< name of scope
+	const char* file;      //< source-file of call-site
+	const char* function;  //< function containing call-site
+	uint32_t    line;      //< line of call-site
+	uint32_t    category;  //< category-bits of scope, see PROFSY_SCOPE_CATEGORY()
+	uint64_t    name_hash; //< hash of name, as calculated by __profsy_hash_name(), or 0 if not known
+};
+
 /**
  * structure describing state of a scope that was measured between
  * the last two profsy_swap_frame()
@@ -75,14 +185,72 @@ struct profsy_scope_data
 	uint64_t time;       //< time spent in scope
 	uint64_t child_time; //< time spent in child-scopes
 	uint64_t calls;      //< number of calls made to this scopes
+	uint64_t max_time;   //< time spent in scope by the thread that spent the most time in it, only differs from time in thread-groups
+	uint64_t suspended_time; //< time a fiber was suspended while in this scope, not included in time
+	uint64_t perf_counters[PROFSY_PERF_COUNTERS_MAX]; //< value of performance-counters accumulated in scope, see profsy_perf_counters_enable()
+	uint64_t context_switches; //< voluntary and involuntary context-switches in scope, only recorded with PROFSY_SCOPE_FLAG_SCHED_INFO
+	uint64_t preempted;        //< number of calls where thread was preempted or migrated to another cpu, only recorded with PROFSY_SCOPE_FLAG_SCHED_INFO
+	uint64_t samples;          //< number of samples taken while this was the innermost scope, see profsy_sampling_enable()
 
 	// stable time
 	// variance
 
 	uint16_t depth;          // depth of scope in call-hierarchy
-	uint16_t num_sub_scopes; // number of child-scopes
+	uint16_t mode;           // PROFSY_SCOPE_MODE_* that scope is recorded with
+	uint32_t num_sub_scopes; // number of scopes in the sub-tree below scope, not only direct children, so it can pass 64k at a root
+	uint32_t category;       // category-bits of scope, set by the call-site that first registered the scope
+	uint64_t path_hash;      // hash of thread-name and path to scope, stable between runs and builds, see profsy_path_hash()
+	const profsy_scope_desc* desc; // call-site that first registered the scope, 0x0 if it was registered without one, i.e. by profsy_scope_enter()
+};
+
+/**
+ * structure describing the state of all scopes with the same name, independent of call-path, that
+ * was measured between the last two profsy_swap_frame()
+ */
+struct profsy_name_data
+{
+	const char* name;    //< name of scopes
+	uint64_t time;       //< time spent in scopes with this name, time in recursive calls is only counted once
+	uint64_t self_time;  //< time spent in scopes with this name, excluding time in child-scopes
+	uint64_t calls;      //< number of calls made to scopes with this name
+};
+
+/**
+ * structure describing state of a counter or gauge at the last profsy_swap_frame()
+ */
+struct profsy_counter_data
+{
+	const char* name;  //< name of counter
+	int64_t     value; //< sum of values added during the frame for counters, last value set for gauges
+	uint16_t    type;  //< type of counter, PROFSY_COUNTER_TYPE_*
 };
 
+/**
+ * structure describing all async spans with the same name that ended between the last two profsy_swap_frame()
+ */
+struct profsy_span_data
+{
+	const char* name;     //< name of spans
+	uint64_t    calls;    //< number of spans that ended
+	uint64_t    time;     //< total time between begin and end of spans
+	uint64_t    max_time; //< longest time between begin and end of a single span
+};
+
+/**
+ * structure describing a frame-domain at its last swap.
+ */
+struct profsy_frame_domain_data
+{
+	const char* name;   //< name of domain
+	uint64_t    frames; //< number of times domain has been swapped
+	uint64_t    time;   //< length of last frame in domain
+};
+
+/**
+ * handle to an async span in flight, 0 is an invalid span.
+ */
+typedef uint64_t profsy_span_t;
+
 /**
  * calculate the amount of memory needed by profsy_init to initialize profsy.
  * @param parmas initialization-parameters that will also be sent to profsy_init
@@ -114,12 +282,25 @@ uint8_t* profsy_shutdown();
 profsy_ctx_t profsy_global_ctx();
 
 /**
- *
+ * create a new thread-ctx that scopes can be registered to.
+ * Thread-ctx:s and scopes can be registered from several os-threads at the same time, registration is serialized by
+ * a lock in profsy while scopes that are already registered are found without taking it.
+ * @param thread_name name of thread, profsy will assume that the name is valid until profsy_shutdown() is called.
+ *                    Paths are hashed from the thread-name so it need to be unique among thread-ctxs and groups.
+ * @return id of thread-ctx or -1 if all thread-ctxs are used or thread_name is already used.
  */
 int profsy_create_thread_ctx( const char* thread_name );
 
 /**
- *
+ * @return name of thread-ctx or 0x0 if thread_ctx is not a valid thread-ctx.
+ */
+const char* profsy_thread_name( int thread_ctx );
+
+/**
+ * set the thread-ctx that profsy_scope_enter()/profsy_scope_leave() and PROFSY_SCOPE will register
+ * scopes to on the calling thread. Threads that never called this will use the "main" thread-ctx.
+ * @param thread_ctx thread-ctx created with profsy_create_thread_ctx().
+ * @return thread_ctx or -1 on error.
  */
 int profsy_set_thread_ctx( int thread_ctx );
 
@@ -128,6 +309,155 @@ int profsy_set_thread_ctx( int thread_ctx );
  */
 int profsy_initialize_thread( const char* thread_name );
 
+/**
+ * create a fiber-ctx. A fiber-ctx works as a thread-ctx with its own scope-tree but is attached to, and detached
+ * from, os-threads with profsy_fiber_switch(). This makes scopes that are entered on one os-thread and left on
+ * another, as with fibers or coroutines, end up in the correct tree.
+ * Time while a fiber is not attached to any os-thread is excluded from the time of its open scopes and reported in
+ * profsy_scope_data::suspended_time instead.
+ * @param fiber_name name of fiber, profsy will assume that the name is valid until profsy_shutdown() is called.
+ * @return id of fiber-ctx or -1 if all thread-ctxs are used or fiber_name is already used.
+ */
+int profsy_create_fiber_ctx( const char* fiber_name );
+
+/**
+ * switch the thread-ctx used by the calling os-thread, used to attach a fiber-ctx when a fiber is resumed and to
+ * attach the previous thread-ctx when it is suspended again.
+ * @param thread_ctx fiber- or thread-ctx to attach to the calling os-thread.
+ * @param tick time of switch.
+ * @return thread-ctx that was attached before the switch or -1 on error.
+ */
+int profsy_fiber_switch( int thread_ctx, uint64_t tick );
+
+/**
+ * add a thread-ctx to a named thread-group. The scope-trees of all threads in a group are summed by path
+ * into one merged tree in profsy_swap_frame(), i.e. a group of identical workers can be viewed as one.
+ * The merged tree is reported as a thread of its own, named as the group, in the hierarchy and can be
+ * searched with profsy_find_scope( "<group-name>/..." ). In the merged tree profsy_scope_data::time is the
+ * total time over all threads and profsy_scope_data::max_time is the max time of a single thread.
+ *
+ * @note the merged tree allocates scopes from the same budget as all other scopes.
+ * @param thread_ctx thread-ctx to add to group.
+ * @param group_name name of group, profsy will assume that the name is valid until profsy_shutdown() is called.
+ * @return thread-ctx id of the merged tree or -1 on error, i.e. if group_name is used by a thread-ctx.
+ */
+int profsy_set_thread_group( int thread_ctx, const char* group_name );
+
+/**
+ * create a new frame-domain. All threads start out in domain 0, that is swapped by profsy_swap_frame(), but threads
+ * that run at another cadence, i.e. a simulation running at 30 Hz while rendering at 144 Hz, can be moved to a domain
+ * of their own with profsy_set_thread_domain() and swapped separately with profsy_swap_domain().
+ * @param domain_name name of domain, profsy will assume that the name is valid until profsy_shutdown() is called.
+ * @return id of new domain or -1 on error.
+ */
+int profsy_create_frame_domain( const char* domain_name );
+
+/**
+ * move a thread-ctx to a frame-domain, scope-data of the thread will from then on be published when that domain is swapped.
+ * @note a thread-group is published together with its own domain, using the latest published data from each thread in the group.
+ * @param thread_ctx thread-ctx to move.
+ * @param domain_id domain to move thread-ctx to.
+ * @return domain_id or -1 on error.
+ */
+int profsy_set_thread_domain( int thread_ctx, int domain_id );
+
+/**
+ * mark end of frame and start of the next one in a frame-domain, this will only publish and reset scopes of threads
+ * in that domain. Swapping domain 0 is the same as calling profsy_swap_frame().
+ * @param domain_id domain to swap.
+ */
+void profsy_swap_domain( int domain_id );
+
+/**
+ * @return data about domain published at its last swap or 0x0 if domain_id is invalid.
+ */
+const profsy_frame_domain_data* profsy_get_frame_domain_data( int domain_id );
+
+/**
+ * enable reading of performance-counters at enter and leave of each scope of a thread-ctx. profsy will try to open
+ * counters for instructions, cycles and cache-misses and fall back to page-faults, cpu-clock and context-switches for
+ * each one that is not available, i.e. when running without a hardware pmu. Counters are accumulated per scope into
+ * profsy_scope_data::perf_counters in the order they were opened, see profsy_perf_counter_name().
+ * @note counters are opened for the calling os-thread, so this need to be called from the os-thread that runs thread_ctx.
+ * @note only supported on linux, returns -1 on other platforms.
+ * @param thread_ctx thread-ctx to enable counters for.
+ * @return number of counters that was opened or -1 on error.
+ */
+int profsy_perf_counters_enable( int thread_ctx );
+
+/**
+ * close all performance-counters opened by profsy_perf_counters_enable(), this is also done by profsy_shutdown().
+ * @param thread_ctx thread-ctx to disable counters for.
+ */
+void profsy_perf_counters_disable( int thread_ctx );
+
+/**
+ * @return name of performance-counter stored at index in profsy_scope_data::perf_counters for thread_ctx or 0x0 if
+ *         no counter is enabled at that index.
+ */
+const char* profsy_perf_counter_name( int thread_ctx, unsigned int index );
+
+/**
+ * enable statistical sampling of the calling os-thread. A timer is started that at each interval of cpu-time consumed
+ * by the thread raises SIGPROF, sampling the innermost scope that the thread is currently in. Samples are counted per
+ * scope in profsy_scope_data::samples, so samples * interval estimates the exclusive time of a scope, including
+ * uninstrumented code called from it, at a fixed overhead independent of call frequency.
+ * Samples of code not inside any scope are counted on the root of the thread.
+ * @note only supported on linux, returns -1 on other platforms.
+ * @note profsy will install a handler for SIGPROF when this is first called.
+ * @note the handler reads a thread-local variable in profsy that is declared with the initial-exec tls-model to be
+ *       async-signal-safe, a shared library with profsy might fail to load with dlopen() if static tls is exhausted.
+ * @param thread_ctx thread-ctx that the calling os-thread is attached to.
+ * @param interval_ns interval between samples in nanoseconds of thread cpu-time.
+ * @return 0 on success or -1 on error.
+ */
+int profsy_sampling_enable( int thread_ctx, uint64_t interval_ns );
+
+/**
+ * stop sampling started with profsy_sampling_enable(), this is also done by profsy_shutdown().
+ * @param thread_ctx thread-ctx passed to profsy_sampling_enable().
+ */
+void profsy_sampling_disable( int thread_ctx );
+
+/**
+ * measure the cost of entering and leaving a scope, i.e. one PROFSY_SCOPE, by running enter/leave of a dummy scope in
+ * a loop on the calling thread. After calibration a built-in scope, "profiler overhead", is registered on the calling
+ * thread that reports the estimated overhead of all scopes published together with it in each swap, i.e. calls is the
+ * number of scopes entered and time is calls * overhead.
+ * @note should be called when not tracing, i.e. right after profsy_init().
+ * @param iterations number of enter/leave to measure, more gives a more stable result.
+ * @return estimated cost in ticks of entering and leaving one scope.
+ */
+uint64_t profsy_calibrate_overhead( unsigned int iterations );
+
+/**
+ * enable or disable subtraction of the overhead measured by profsy_calibrate_overhead() from published scope-data.
+ * When enabled profsy_scope_data::time of a scope is reduced by overhead times the number of calls to all its
+ * sub-scopes and profsy_scope_data::child_time is reduced in the same way by the calls below its direct children.
+ * @param enable true to enable subtraction.
+ */
+void profsy_subtract_overhead( bool enable );
+
+/**
+ * set a budget for the estimated profiler-overhead per frame, see profsy_calibrate_overhead(). When the estimated
+ * overhead of a frame-domain exceeds the budget in a swap, profsy will switch leaf-scopes that are cheaper than the
+ * overhead itself to PROFSY_SCOPE_MODE_COUNT_ONLY, most called first, and then count-only scopes to
+ * PROFSY_SCOPE_MODE_OFF until the estimate is within budget. The mode of each scope is reported in
+ * profsy_scope_data::mode and can be reset with profsy_set_scope_mode().
+ * Scopes in a cheaper mode skip the leave-call and its timer-read, the PROFSY_SCOPE()-macros still read the timer
+ * once at enter since the mode is only known after the scope has been looked up.
+ * @param ticks_per_frame budget in ticks, 0 disables the budget.
+ */
+void profsy_set_overhead_budget( uint64_t ticks_per_frame );
+
+/**
+ * set mode of a scope, only leaf-scopes can be set to another mode than PROFSY_SCOPE_MODE_FULL.
+ * @param scope_id id of scope, i.e. from profsy_find_scope().
+ * @param mode PROFSY_SCOPE_MODE_* to set.
+ * @return 0 on success or -1 on error.
+ */
+int profsy_set_scope_mode( int scope_id, uint16_t mode );
+
 // TODO: add functions to alloc scopes outside of macro
 
 /**
@@ -151,7 +481,93 @@ int profsy_scope_enter( const char* name, uint64_t time );
 void profsy_scope_leave( int scope_id, uint64_t start, uint64_t end );
 
 /**
- * mark end of frame and start of the next one.
+ * add calls and time to a child-scope of the current scope of the calling thread without entering it, used to
+ * report work measured outside of profsy, i.e. by PROFSY_SCOPE_LOOP(). Nothing is added to the trace.
+ * @param name name of scope, profsy will assume that the name is valid until profsy_shutdown() is called.
+ * @param calls number of calls to add to scope.
+ * @param time time to add to scope.
+ */
+void profsy_scope_add( const char* name, uint64_t calls, uint64_t time );
+
+/**
+ * same as profsy_scope_enter() but with the hash of name precomputed, the hash is used to find the scope in the
+ * path-index instead of searching the children of the current scope.
+ * @param name_hash hash of name, as calculated by __profsy_hash_name().
+ */
+int profsy_scope_enter_hashed( const char* name, uint64_t name_hash, uint64_t time );
+
+/**
+ * same as profsy_scope_enter() but with a static descriptor of the call-site, used by PROFSY_SCOPE(). The descriptor
+ * is referenced by the scope when it is first registered and reported in profsy_scope_data::desc.
+ * @param desc descriptor of call-site, profsy will assume that it is valid until profsy_shutdown() is called.
+ */
+int profsy_scope_enter_desc( const profsy_scope_desc* desc, uint64_t time );
+
+/**
+ * same as profsy_scope_enter_desc() but with integer arguments attached to the scope in the trace, used by
+ * PROFSY_SCOPE_ARG1()/PROFSY_SCOPE_ARG2(). The enter and its arguments are written to the trace together so that
+ * events from other os-threads can not end up between them.
+ * @param args arguments to add.
+ * @param num_args number of arguments in args.
+ */
+int profsy_scope_enter_args( const profsy_scope_desc* desc, uint64_t time, const int64_t* args, unsigned int num_args );
+
+/**
+ * same as profsy_scope_enter() but with category-bits for the scope, see PROFSY_SCOPE_CATEGORY().
+ */
+int profsy_scope_enter_category( const char* name, uint32_t category, uint64_t time );
+
+/**
+ * global mask of enabled scope-categories, scopes in PROFSY_SCOPE_CATEGORY()/PROFSY_SCOPE() that has no bit in common
+ * with the mask are skipped before time is read. Defaults to PROFSY_CATEGORY_ALL and is kept over profsy_init()/profsy_shutdown().
+ * @note use profsy_set_category_mask() to change.
+ */
+extern uint32_t g_profsy_category_mask;
+
+/**
+ * set global mask of enabled scope-categories.
+ * @param mask categories to enable.
+ */
+void profsy_set_category_mask( uint32_t mask );
+
+/**
+ * restrict trace-capture to scopes with category-bits in mask to save space in the trace-buffer, scopes still
+ * record time when not traced.
+ * @param mask categories to trace, PROFSY_CATEGORY_ALL by default.
+ */
+void profsy_set_trace_category_mask( uint32_t mask );
+
+/**
+ * restrict trace-capture to scopes at depth max_depth or less, where the scopes entered directly in a thread is at
+ * depth 1. Scopes still record time when not traced.
+ * @param max_depth max depth to trace, 0 to trace all depths which is the default.
+ */
+void profsy_set_trace_max_depth( unsigned int max_depth );
+
+/**
+ * drop scopes that are shorter than min_duration from the trace. Scope-enters are held back on a per-thread stack
+ * until the scope is left and only written if the scope was long enough, or if any other event was traced on the
+ * thread while it was open, i.e. a child-scope, argument or instant.
+ * @param min_duration min duration in ticks for a scope to be traced, 0 to trace all scopes which is the default.
+ */
+void profsy_set_trace_min_duration( uint64_t min_duration );
+
+/**
+ * include or exclude the scope with path_hash, and all its child-scopes, from the trace. If any scope is included
+ * only included scopes are traced. Filters on nested scopes override filters on their parents.
+ * @param path_hash path-hash of scope, see profsy_path_hash(). The hash of a thread-root, "thread/", filters a whole thread.
+ * @param include true to include scope, false to exclude it.
+ * @return false if PROFSY_TRACE_FILTER_SCOPES_MAX filters are already set.
+ */
+bool profsy_trace_filter_scope( uint64_t path_hash, bool include );
+
+/**
+ * remove all filters set by profsy_trace_filter_scope().
+ */
+void profsy_trace_clear_scope_filters();
+
+/**
+ * mark end of frame and start of the next one in frame-domain 0.
  * in this call profsy will reset all counters, start/stop-tracing etc.
  */
 void profsy_swap_frame();
@@ -169,6 +585,35 @@ void profsy_trace_begin( profsy_trace_entry* entries,
 						 unsigned int        num_entries, 
 						 unsigned int        frames_to_capture );
 
+/**
+ * add an instant event to the trace, i.e. a marker of something happening at a specific time such as
+ * "level loaded". Instant events are only recorded while tracing.
+ * @param name name of event, profsy will assume that the name is valid until profsy_shutdown() is called.
+ * @param tick time of event.
+ */
+void profsy_instant( const char* name, uint64_t tick );
+
+/**
+ * attach integer arguments to the last event added to the trace, used to add arguments to
+ * scope-enters and instant events. Arguments are only recorded while tracing.
+ * @param args arguments to add.
+ * @param num_args number of arguments in args.
+ */
+void profsy_trace_args( const int64_t* args, unsigned int num_args );
+
+/**
+ * add flow-events to the trace, used to link work across threads such as a job that is scheduled on one
+ * thread and executed on another. A flow is started with profsy_flow_begin(), can pass through any number
+ * of profsy_flow_step() and is finished by profsy_flow_end(), all called with the same name and flow_id.
+ * Flow-events are bound to the scope that is open on the calling thread and only recorded while tracing.
+ * @param name name of flow, profsy will assume that the name is valid until profsy_shutdown() is called.
+ * @param flow_id id unique to this flow among all flows in flight.
+ * @param tick time of event.
+ */
+void profsy_flow_begin( const char* name, uint64_t flow_id, uint64_t tick );
+void profsy_flow_step ( const char* name, uint64_t flow_id, uint64_t tick );
+void profsy_flow_end  ( const char* name, uint64_t flow_id, uint64_t tick );
+
 /**
  * return the status of tracing.
  * profsy will assume that the entries-buffer sent to profsy_trace_begin() is valid until this 
@@ -188,49 +633,422 @@ unsigned int profsy_max_active_scopes();
 unsigned int profsy_num_active_scopes();
 
 /**
- * return the index of a path with a specific path in the call hierarchy.
- *
- * TODO: this doc is now wrong!
+ * begin an async span, i.e. work that is started in one place and finished much later in a callback or on
+ * another thread, such as streaming-requests and network round-trips.
+ * Spans are recorded as async events in the trace and their duration is accumulated per name.
+ * @param name name of span, profsy will assume that the name is valid until profsy_shutdown() is called.
+ * @param tick time when span began.
+ * @return handle to pass to profsy_span_end() or 0 if no more spans can be in flight.
+ */
+profsy_span_t profsy_span_begin( const char* name, uint64_t tick );
+
+/**
+ * end an async span started with profsy_span_begin(), can be called from any thread.
+ * @param span handle returned by profsy_span_begin(), ending an invalid or already ended span is a no-op.
+ * @param tick time when span ended.
+ */
+void profsy_span_end( profsy_span_t span, uint64_t tick );
+
+/**
+ * return statistics for all async span-names.
+ * @param spans array to fill with span-data, ordered by when the name was first seen.
+ * @param num_spans size of spans-array.
+ * @return number of items written to spans.
+ */
+unsigned int profsy_get_span_data( const profsy_span_data** spans, unsigned int num_spans );
+
+/**
+ * register a counter or gauge, registering the same name twice returns the same id.
+ * @param name name of counter, profsy will assume that the name is valid until profsy_shutdown() is called.
+ * @param type type of counter, PROFSY_COUNTER_TYPE_*
+ * @return id of counter or -1 if all counters are used.
+ */
+int profsy_counter_register( const char* name, uint16_t type );
+
+/**
+ * add value to a counter registered with PROFSY_COUNTER_TYPE_COUNTER.
+ */
+void profsy_counter_add( int counter_id, int64_t value );
+
+/**
+ * set value of a counter registered with PROFSY_COUNTER_TYPE_GAUGE.
+ */
+void profsy_gauge_set( int counter_id, int64_t value );
+
+/**
+ * @param counter_id id of counter to return data for
+ * @return counter-data published in the last profsy_swap_frame() for counter with specific id
+ */
+profsy_counter_data* profsy_get_counter_data( int counter_id );
+
+/**
+ * @return num registered counters and gauges, counter-ids are in the range [0, profsy_num_counters())
+ */
+unsigned int profsy_num_counters();
+
+/**
+ * return the index of a scope with a specific path in the call hierarchy.
+ * scopes are separated with '.' and a path can be prefixed with "<thread-name>/" to search the
+ * scopes of a specific thread, paths without a thread-prefix is searched in the first thread ( "main" ).
+ * lookups are done in a hash-table that is updated when scopes are allocated.
  *
- * @example profsy_find_scope( "" ) -> will return index of "root"
- * @example profsy_find_scope( "scope1" ) -> will return index of "scope1"
- * @example profsy_find_scope( "scope1/scope2" ) -> will return index of "scope2" if called under "scope1"
- * @return the index of scope with path
+ * @example profsy_find_scope( "" ) -> will return index of "main"-root
+ * @example profsy_find_scope( "scope1" ) -> will return index of "scope1" if called under "main"-root
+ * @example profsy_find_scope( "scope1.scope2" ) -> will return index of "scope2" if called under "scope1"
+ * @example profsy_find_scope( "render/" ) -> will return index of root of thread "render"
+ * @example profsy_find_scope( "render/scope1.scope2" ) -> will return index of "scope2" if called under "scope1" on thread "render"
+ * @return the index of scope with path or -1 if not found
  */
 int profsy_find_scope( const char* scope_path );
 
+/**
+ * calculate the path-hash of a scope-path, as stored in profsy_scope_data::path_hash, does not need an initialized profsy.
+ * @param scope_path path formatted as in profsy_find_scope().
+ * @return hash of path.
+ */
+uint64_t profsy_path_hash( const char* scope_path );
+
+/**
+ * find scope by path-hash, i.e. from profsy_path_hash() or profsy_scope_data::path_hash of an earlier capture.
+ * @return the index of scope with path-hash or -1 if not found.
+ */
+int profsy_find_scope_by_hash( uint64_t path_hash );
+
 /**
  * @param scope_id id of scope to return data for
  * @return scope-data for scope with specific id
  */
 profsy_scope_data* profsy_get_scope_data( int scope_id );
 
+/**
+ * set flags on a scope, controlling what is recorded for it.
+ * PROFSY_SCOPE_FLAG_SCHED_INFO - record cpu-id and context-switches at enter and leave to be able to tell if a slow
+ *                                call was due to the thread being preempted or migrated. Calls where that happened are
+ *                                counted in profsy_scope_data::preempted and the LEAVE-event in a trace is followed by
+ *                                ARG-events with PROFSY_TRACE_ARG_CPU and PROFSY_TRACE_ARG_CONTEXT_SWITCHES.
+ * PROFSY_SCOPE_FLAG_COLLAPSE_RECURSION - entering a scope with the same name directly under this scope, i.e. a recursive
+ *                                        function, is registered to this scope instead of allocating a new child-scope
+ *                                        per recursion-depth. Time is only counted for the outermost call while calls
+ *                                        are counted for all of them.
+ * @note sched-info is only recorded on linux.
+ * @param scope_id id of scope, i.e. from profsy_find_scope().
+ * @param flags PROFSY_SCOPE_FLAG_*-flags to set, replacing current flags.
+ * @return 0 on success or -1 if scope_id is not a valid scope.
+ */
+int profsy_set_scope_flags( int scope_id, uint32_t flags );
+
+/**
+ * @return PROFSY_SCOPE_FLAG_*-flags set on scope or 0 if scope_id is not a valid scope.
+ */
+uint32_t profsy_get_scope_flags( int scope_id );
+
+/**
+ * return data for scopes that did not fit in the entry-budget and was registered to the "overflow"-scope of
+ * a thread. Overflowed scopes are accounted per name, not per path, so the same name called from different
+ * parents will be summed up in one item.
+ * @param thread_id thread to fetch overflowed scopes for.
+ * @param scopes array to fill with overflowed scopes, ordered by when they first overflowed.
+ * @param num_scopes size of scopes-array.
+ * @return number of items written to scopes.
+ */
+unsigned int profsy_get_overflow_scopes( int thread_id, const profsy_scope_data** scopes, unsigned int num_scopes );
+
+/**
+ * return data for all scope-names aggregated over all call-paths and threads. The data is updated in
+ * profsy_swap_frame().
+ * @param names array to fill with name-data, ordered by when the name was first seen.
+ * @param num_names size of names-array.
+ * @return number of items written to names.
+ */
+unsigned int profsy_get_name_data( const profsy_name_data** names, unsigned int num_names );
+
+/**
+ * same as profsy_get_scope_hierarchy() but only for the scopes of one thread-ctx.
+ * @param thread_ctx thread-ctx to get scopes for.
+ * @param child_scopes array to fill with scopes.
+ * @param num_child_scopes size of child_scopes, no more than this amount of scopes will be written.
+ * @return number of scopes written to child_scopes.
+ */
+unsigned int profsy_get_thread_hierarchy( int thread_ctx, const profsy_scope_data** child_scopes, unsigned int num_child_scopes );
+
 /**
  * used to generate a hierarchy-structure of the nodes for output. The result is a list that can be printed
  * from top to bottom and get a call-graph of all registered scopes.
+ * the "overflow"-scope of each thread is reported last for that thread, followed by all overflowed scope-names.
+ * @note the hierarchy is kept up to date by profsy as scopes are allocated so this is only a copy.
+ * @param child_scopes array to fill with scopes.
+ * @param num_child_scopes size of child_scopes, no more than this amount of scopes will be written.
+ * @return number of scopes written to child_scopes.
+ */
+unsigned int profsy_get_scope_hierarchy( const profsy_scope_data** child_scopes, unsigned int num_child_scopes );
+
+/**
+ * same as profsy_get_scope_hierarchy() but return a view of the hierarchy kept by profsy instead of
+ * copying it.
+ * @note the returned view is valid until the next scope is allocated or profsy_shutdown() is called.
+ * @param num_scopes number of items in returned array.
+ * @return array of all scopes in hierarchy-order.
  */
-void profsy_get_scope_hierarchy( const profsy_scope_data** child_scopes, unsigned int num_child_scopes );
+const profsy_scope_data* const* profsy_scope_hierarchy( unsigned int* num_scopes );
 
 #if defined(__cplusplus)
+
+/**
+ * if PROFSY_HAS_CONSTEXPR is set the hash of scope-names in PROFSY_SCOPE() is calculated at compile-time when possible,
+ * defaults to on for c++11 and later.
+ */
+#if !defined( PROFSY_HAS_CONSTEXPR )
+	#if __cplusplus >= 201103L || ( defined(_MSC_VER) && _MSC_VER >= 1900 )
+		#define PROFSY_HAS_CONSTEXPR 1
+	#else
+		#define PROFSY_HAS_CONSTEXPR 0
+	#endif
+#endif
+
+#if PROFSY_HAS_CONSTEXPR
+	#define PROFSY_CONSTEXPR constexpr
+#else
+	#define PROFSY_CONSTEXPR
+#endif
+
+/**
+ * fnv1a-64 hash of a scope-name, same as used for profsy_scope_data::path_hash.
+ */
+static inline PROFSY_CONSTEXPR uint64_t __profsy_hash_name( const char* str, uint64_t hash = 0xcbf29ce484222325ULL )
+{
+	return *str == '\0' ? hash : __profsy_hash_name( str + 1, ( hash ^ (uint8_t)*str ) * 0x100000001b3ULL );
+}
+
+#if defined(_MSC_VER)
+	#define PROFSY_FUNCTION __FUNCTION__
+#else
+	#define PROFSY_FUNCTION __func__
+#endif
+
 struct __profsy_scope
 {
 	int      scope_id;
 	uint64_t start;
 
-	__profsy_scope( const char* scope_name )
-		: start( PROFSY_CUSTOM_TICK_FUNC() )
+	explicit __profsy_scope( const profsy_scope_desc* desc )
+		: scope_id( -1 )
+		, start( 0 )
 	{
-		scope_id = profsy_scope_enter( scope_name, start );
+		if( ( g_profsy_category_mask & desc->category ) == 0 )
+			return;
+		start    = PROFSY_CUSTOM_TICK_FUNC();
+		scope_id = profsy_scope_enter_desc( desc, start );
 	}
 
-	~__profsy_scope() { profsy_scope_leave( scope_id, start, PROFSY_CUSTOM_TICK_FUNC() ); }
+	__profsy_scope( const profsy_scope_desc* desc, int64_t arg0 )
+		: scope_id( -1 )
+		, start( 0 )
+	{
+		if( ( g_profsy_category_mask & desc->category ) == 0 )
+			return;
+		start    = PROFSY_CUSTOM_TICK_FUNC();
+		scope_id = profsy_scope_enter_args( desc, start, &arg0, 1 );
+	}
+
+	__profsy_scope( const profsy_scope_desc* desc, int64_t arg0, int64_t arg1 )
+		: scope_id( -1 )
+		, start( 0 )
+	{
+		if( ( g_profsy_category_mask & desc->category ) == 0 )
+			return;
+		start    = PROFSY_CUSTOM_TICK_FUNC();
+		int64_t args[] = { arg0, arg1 };
+		scope_id = profsy_scope_enter_args( desc, start, args, 2 );
+	}
+
+	// ... scopes with names only known at runtime has no call-site descriptor and are entered by name ...
+	__profsy_scope( const char* name, uint32_t category )
+		: scope_id( -1 )
+		, start( 0 )
+	{
+		if( ( g_profsy_category_mask & category ) == 0 )
+			return;
+		start    = PROFSY_CUSTOM_TICK_FUNC();
+		scope_id = profsy_scope_enter_category( name, category, start );
+	}
+
+	~__profsy_scope()
+	{
+		// ... scopes not recorded in full are already done at enter ...
+		if( scope_id >= 0 )
+			profsy_scope_leave( scope_id, start, PROFSY_CUSTOM_TICK_FUNC() );
+	}
+};
+
+/**
+ * accumulator for a loop-scope, see PROFSY_SCOPE_LOOP().
+ */
+struct __profsy_loop_scope
+{
+	const char*  name;
+	unsigned int sample_rate; // time every sample_rate:th iteration.
+	unsigned int iterations;
+	unsigned int sampled;     // number of timed iterations.
+	uint64_t     time;        // time of all timed iterations.
+	uint64_t     start;
+	bool         enabled;
+
+	__profsy_loop_scope( const char* scope_name, unsigned int rate )
+		: name( scope_name )
+		, sample_rate( rate == 0 ? 1 : rate )
+		, iterations( 0 )
+		, sampled( 0 )
+		, time( 0 )
+		, start( 0 )
+		, enabled( ( g_profsy_category_mask & PROFSY_CATEGORY_DEFAULT ) != 0 )
+	{}
+
+	~__profsy_loop_scope()
+	{
+		// ... first iteration is always timed so sampled is > 0 if there was any iterations ...
+		if( enabled && iterations > 0 )
+			profsy_scope_add( name, iterations, sampled == iterations ? time : time * iterations / sampled );
+	}
+};
+
+struct __profsy_loop_iter
+{
+	__profsy_loop_scope& loop;
+	bool                 timed;
+
+	__profsy_loop_iter( __profsy_loop_scope& loop_scope )
+		: loop( loop_scope )
+		, timed( loop_scope.enabled && loop_scope.iterations % loop_scope.sample_rate == 0 )
+	{
+		++loop.iterations;
+		if( timed )
+			loop.start = PROFSY_CUSTOM_TICK_FUNC();
+	}
+
+	~__profsy_loop_iter()
+	{
+		if( timed )
+		{
+			loop.time += PROFSY_CUSTOM_TICK_FUNC() - loop.start;
+			++loop.sampled;
+		}
+	}
+};
+
+/**
+ * a counter call-site, caches the counter-id for the current profsy-context.
+ */
+struct __profsy_counter_site
+{
+	const char*  name;
+	uint16_t     type;
+	int          counter_id;
+	unsigned int generation;
 };
 
+void __profsy_counter_add( __profsy_counter_site* site, int64_t value );
+void __profsy_gauge_set( __profsy_counter_site* site, int64_t value );
+
+/**
+ * static descriptor of a scope call-site, with a constant name it is initialized at compile-time when
+ * PROFSY_HAS_CONSTEXPR is set and otherwise once, the first time the call-site is reached.
+ */
+#define __PROFSY_SCOPE_DESC( name, category ) \
+	static const profsy_scope_desc __PROFSY_UNIQUE_SYM(__profile_scope_desc_) = { name, __FILE__, PROFSY_FUNCTION, __LINE__, category, __profsy_hash_name( name ) }
+
 /**
  * macro to define a scope within c++-code.
  * @param name name of scope as a constant string, profsy will assue that the name is valid until profsy_shutdown() is called.
+ *             The call-site is registered with the name it is first reached with, use PROFSY_SCOPE_DYNAMIC() for names
+ *             that change between calls.
+ */
+#define PROFSY_SCOPE( name ) PROFSY_SCOPE_CATEGORY( name, PROFSY_CATEGORY_DEFAULT )
+
+/**
+ * same as PROFSY_SCOPE() but with category-bits, the scope is skipped without reading time if no bit in category is
+ * set in g_profsy_category_mask.
+ * @example PROFSY_SCOPE_CATEGORY( "draw_meshes", MY_CATEGORY_RENDER );
+ */
+#define PROFSY_SCOPE_CATEGORY( name, category ) \
+	__PROFSY_SCOPE_DESC( name, category ); \
+	__profsy_scope __PROFSY_UNIQUE_SYM(__profile_scope_ )( &__PROFSY_UNIQUE_SYM(__profile_scope_desc_) )
+
+/**
+ * same as PROFSY_SCOPE_CATEGORY() but for names that are only known at runtime and might change between calls, i.e.
+ * built from an asset-name. The scope is found by name on each call and registered without call-site.
+ * @example PROFSY_SCOPE_DYNAMIC( job->name, PROFSY_CATEGORY_DEFAULT );
+ */
+#define PROFSY_SCOPE_DYNAMIC( name, category ) \
+	__profsy_scope __PROFSY_UNIQUE_SYM(__profile_scope_ )( name, (uint32_t)( category ) )
+
+/**
+ * macros to time the iterations of a tight loop as one scope, calls and time is accumulated on the stack and added
+ * to the scope once when the PROFSY_SCOPE_LOOP() goes out of scope, avoiding the cost of entering and leaving the
+ * scope on each iteration. Scopes entered inside the loop are registered as siblings of the loop-scope.
+ * PROFSY_SCOPE_LOOP_SAMPLED() only times every n:th iteration and extrapolates the time to all iterations.
+ * @example
+ * PROFSY_SCOPE_LOOP( particles, "update_particle" );
+ * for( int i = 0; i < num_particles; ++i )
+ * {
+ *     PROFSY_SCOPE_LOOP_ITER( particles );
+ *     update_particle( i );
+ * }
+ */
+#define PROFSY_SCOPE_LOOP( var, name )            __profsy_loop_scope var( name, 1 )
+#define PROFSY_SCOPE_LOOP_SAMPLED( var, name, n ) __profsy_loop_scope var( name, n )
+#define PROFSY_SCOPE_LOOP_ITER( var )             __profsy_loop_iter __PROFSY_UNIQUE_SYM(__profile_loop_iter_ )( var )
+
+/**
+ * same as PROFSY_SCOPE() but attach integer arguments to the scope in the trace, i.e. batch-size, entity-id etc.
+ */
+#define PROFSY_SCOPE_ARG1( name, arg0 ) \
+	__PROFSY_SCOPE_DESC( name, PROFSY_CATEGORY_DEFAULT ); \
+	__profsy_scope __PROFSY_UNIQUE_SYM(__profile_scope_ )( &__PROFSY_UNIQUE_SYM(__profile_scope_desc_), (int64_t)( arg0 ) )
+#define PROFSY_SCOPE_ARG2( name, arg0, arg1 ) \
+	__PROFSY_SCOPE_DESC( name, PROFSY_CATEGORY_DEFAULT ); \
+	__profsy_scope __PROFSY_UNIQUE_SYM(__profile_scope_ )( &__PROFSY_UNIQUE_SYM(__profile_scope_desc_), (int64_t)( arg0 ), (int64_t)( arg1 ) )
+
+/**
+ * macro to add an instant event to the trace.
+ * @param name name of event as a constant string, profsy will assue that the name is valid until profsy_shutdown() is called.
+ */
+#define PROFSY_INSTANT( name ) profsy_instant( name, PROFSY_CUSTOM_TICK_FUNC() )
+
+/**
+ * macros to begin and end async spans, see profsy_span_begin().
+ */
+#define PROFSY_SPAN_BEGIN( name ) profsy_span_begin( name, PROFSY_CUSTOM_TICK_FUNC() )
+#define PROFSY_SPAN_END( span )   profsy_span_end( span, PROFSY_CUSTOM_TICK_FUNC() )
+
+/**
+ * macro to switch fiber-ctx, see profsy_fiber_switch().
+ */
+#define PROFSY_FIBER_SWITCH( thread_ctx ) profsy_fiber_switch( thread_ctx, PROFSY_CUSTOM_TICK_FUNC() )
+
+/**
+ * macros to add flow-events to the trace, see profsy_flow_begin().
+ */
+#define PROFSY_FLOW_BEGIN( name, flow_id ) profsy_flow_begin( name, (uint64_t)( flow_id ), PROFSY_CUSTOM_TICK_FUNC() )
+#define PROFSY_FLOW_STEP( name, flow_id )  profsy_flow_step ( name, (uint64_t)( flow_id ), PROFSY_CUSTOM_TICK_FUNC() )
+#define PROFSY_FLOW_END( name, flow_id )   profsy_flow_end  ( name, (uint64_t)( flow_id ), PROFSY_CUSTOM_TICK_FUNC() )
+
+/**
+ * macro to add a value to a counter, the counter will be registered at first use.
+ * @param name name of counter as a constant string, profsy will assue that the name is valid until profsy_shutdown() is called.
+ * @param value value to add to counter.
+ */
+#define PROFSY_COUNTER( name, value ) \
+	do { static __profsy_counter_site __PROFSY_UNIQUE_SYM(__profsy_counter_) = { name, PROFSY_COUNTER_TYPE_COUNTER, -1, 0 }; \
+		 __profsy_counter_add( &__PROFSY_UNIQUE_SYM(__profsy_counter_), (int64_t)( value ) ); } while( false )
+
+/**
+ * macro to set the value of a gauge, the gauge will be registered at first use.
+ * @param name name of gauge as a constant string, profsy will assue that the name is valid until profsy_shutdown() is called.
+ * @param value value to set.
  */
-#define PROFSY_SCOPE( name ) __profsy_scope __PROFSY_UNIQUE_SYM(__profile_scope_ )( name )
+#define PROFSY_GAUGE( name, value ) \
+	do { static __profsy_counter_site __PROFSY_UNIQUE_SYM(__profsy_gauge_) = { name, PROFSY_COUNTER_TYPE_GAUGE, -1, 0 }; \
+		 __profsy_gauge_set( &__PROFSY_UNIQUE_SYM(__profsy_gauge_), (int64_t)( value ) ); } while( false )
 
 #endif // defined(__cplusplus)
 
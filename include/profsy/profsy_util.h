@@ -31,10 +31,12 @@
 
 #include <stdio.h>
 
-static const unsigned int PROFSY_UTIL_DUMP_FORMAT_TEXT = 0;   //< a simple text-format to use in conjunction together with printf or similar
+static const unsigned int PROFSY_UTIL_DUMP_FORMAT_TEXT = 0;   //< "folded stacks", one line per scope-call as "thread;scope;child-scope <self-time>", to use with flamegraph.pl, speedscope or similar
 static const unsigned int PROFSY_UTIL_DUMP_FORMAT_CHROME = 1; //< a json-based format to use togeher with chrome://tracing/ in googles chrome-browser
+static const unsigned int PROFSY_UTIL_DUMP_FORMAT_SPEEDSCOPE = 2; //< speedscopes evented json-format, one profile per thread, to use with https://www.speedscope.app/
+static const unsigned int PROFSY_UTIL_DUMP_FORMAT_PERFETTO = 3;   //< perfettos binary protobuf-format with TrackEvent-packets, to use with https://ui.perfetto.dev/
 
-static const unsigned int PROFSY_UTIL_DUMP_MODE_LINE = 0;  //< call dump-callback for each line in output.
+static const unsigned int PROFSY_UTIL_DUMP_MODE_LINE = 0;  //< call dump-callback for each line in output, or each packet in binary formats.
 static const unsigned int PROFSY_UTIL_DUMP_MODE_CHUNK = 1; //< call dump-callback in larger chuncks.
 
 /**
@@ -67,4 +69,22 @@ void profsy_util_dump_to_stream( FILE* s, profsy_trace_entry* entries, unsigned
  */
 void profsy_util_dump_to_file( const char* filename, profsy_trace_entry* entries, unsigned int format );
 
+/**
+ * dump the scope-tree, as published at the last profsy_swap_frame(), with custom callback in the same "folded stacks"-format
+ * as PROFSY_UTIL_DUMP_FORMAT_TEXT with one line per scope and its self-time. Thread-groups are written as threads of
+ * their own as in profsy_scope_hierarchy().
+ * @param mode dump-mode to use ( PROFSY_UTIL_DUMP_MODE_* )
+ * @param callback callback to use.
+ * @param userdata that will be sent callback at dump
+ */
+void profsy_util_dump_tree( unsigned int mode,
+							void ( *callback )( const uint8_t* data, size_t byte_count, void* userdata ),
+							void* userdata );
+
+/**
+ * dump the scope-tree to stream, see profsy_util_dump_tree().
+ * @param s stream to dump to
+ */
+void profsy_util_dump_tree_to_stream( FILE* s );
+
 #endif // PROFSY_UTIL_H_INCLUDED
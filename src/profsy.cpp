@@ -27,6 +27,21 @@
 #include <profsy/profsy.h>
 
 #include <string.h>
+#include <stdlib.h>
+
+#if defined(_MSC_VER)
+	#include <intrin.h>
+#endif
+
+#if defined(__linux__)
+	#include <signal.h>
+	#include <time.h>
+	#include <sched.h>
+	#include <sys/resource.h>
+	#include <linux/perf_event.h>
+	#include <sys/syscall.h>
+	#include <unistd.h>
+#endif
 
 #define ALIGN_UP( in, alignment ) (size_t)( ( (size_t)(in) + (size_t)(alignment) - 1 ) & ~( (size_t)(alignment) - 1 ) )
 
@@ -36,6 +51,13 @@ const unsigned int PROFSY_BUILTIN_SCOPES = 2; // "<thread-name>"- and "overflow"
 
 // TODO: replace ptrs in profsy_entry and profsy_thread to uint16 to save lots of bytes!
 
+struct profsy_sched_info
+{
+	int      cpu;
+	uint64_t voluntary_switches;
+	uint64_t involuntary_switches;
+};
+
 struct profsy_entry
 {
 	profsy_scope_data data;
@@ -43,6 +65,36 @@ struct profsy_entry
 	uint64_t time;
 	uint64_t child_time;
 	uint64_t calls;
+	uint64_t suspended_time;
+
+	uint64_t suspend_mark; // profsy_thread::suspended_total of a fiber when this scope was entered.
+
+	uint64_t perf[PROFSY_PERF_COUNTERS_MAX];      // accumulated performance-counters.
+	uint64_t perf_mark[PROFSY_PERF_COUNTERS_MAX]; // performance-counters when this scope was entered.
+
+	uint32_t flags; // PROFSY_SCOPE_FLAG_*
+	uint32_t recursion_depth; // number of times this scope is re-entered under itself with PROFSY_SCOPE_FLAG_COLLAPSE_RECURSION.
+
+	uint64_t context_switches;
+	uint64_t preempted;
+	uint64_t samples;
+
+	uint64_t sub_calls;   // calls to all sub-scopes during frame, only calculated when subtracting overhead.
+	uint64_t child_calls; // calls to direct child-scopes during frame, only calculated when subtracting overhead.
+	profsy_sched_info sched_mark; // sched-info when this scope was entered if PROFSY_SCOPE_FLAG_SCHED_INFO is set.
+
+	unsigned int flat_index; // index of this entry in ctx->hierarchy, for the overflow-scope this is the index after the thread-tree.
+	unsigned int flat_size;  // number of items in ctx->hierarchy occupied by this entry and all its child-scopes.
+
+	unsigned int name_index; // index in ctx->names for this entry or PROFSY_NAME_INDEX_NONE.
+	bool         recursive;  // true if any parent-scope has the same name as this.
+	bool         trace_included; // false if this scope is excluded from trace by profsy_trace_filter_scope().
+
+	int           thread_id; // thread that this entry was allocated for.
+	profsy_entry* merged;    // entry with the same path in the thread-group of the thread owning this entry, if any.
+
+	uint64_t name_hash; // hash of data.name.
+	uint64_t path_hash; // hash of the full path to this entry, including thread, used as key in ctx->path_index.
 
 	profsy_entry* parent;
 	profsy_entry* children;
@@ -50,17 +102,100 @@ struct profsy_entry
 };
 
 
+// accumulated data for one scope-name that was registered to the overflow-scope.
+struct profsy_overflow_name
+{
+	profsy_scope_data data;
+
+	uint64_t time;
+	uint64_t calls;
+};
+
+// a scope-enter held back from the trace until it is known if the scope is long enough to be traced.
+struct profsy_trace_pending
+{
+	uint64_t tick;
+	int      scope_id;
+};
+
+// size of hash-table used to find overflow names, keep it at 2x to keep the probe-chains short.
+static const unsigned int PROFSY_OVERFLOW_LOOKUP_SIZE = PROFSY_OVERFLOW_NAMES_MAX * 2;
+
 struct profsy_thread
 {
 	const char*   name;
 	profsy_entry* root;     // root scope for this thread.
 	profsy_entry* overflow; // overflow scope for this thread.
 	profsy_entry* current;  // current scope for this thread.
+
+	bool is_group; // true if this is not a real thread but the merged tree of all threads in a group.
+	bool is_fiber; // true if this is a fiber-ctx that is attached to os-threads with profsy_fiber_switch().
+
+	bool     trace_filtered;  // true if the last scope entered was not traced due to trace-filters, its args should not be traced either.
+
+	profsy_trace_pending trace_pending[PROFSY_TRACE_PENDING_MAX]; // scope-enters not yet written to trace, see profsy_set_trace_min_duration().
+	unsigned int         trace_pending_used;
+	unsigned int         trace_pending_written; // number of items at the bottom of trace_pending that has been written to trace.
+
+	bool     suspended;       // true if fiber is currently detached from all os-threads.
+	uint64_t suspend_start;   // time when fiber was last detached from an os-thread.
+	uint64_t suspended_total; // total time fiber has been detached from os-threads.
+	int  group_id; // id of thread-group this thread is merged into, or -1.
+	int  domain_id; // id of frame-domain this thread is published in.
+
+	unsigned int perf_used;                              // number of opened performance-counters.
+	int          perf_fds[PROFSY_PERF_COUNTERS_MAX];     // perf_event fds, the first one is group-leader.
+	const char*  perf_names[PROFSY_PERF_COUNTERS_MAX];
+
+	bool              sampling;                     // true if a sampling-timer is running for this thread.
+#if defined(__linux__)
+	timer_t           sample_timer;
+#endif
+	volatile uint32_t samples_write;                // written by signal-handler only.
+	volatile uint32_t samples_read;                 // written by profsy_swap_frame() only.
+	uint32_t          samples[PROFSY_SAMPLES_MAX];  // ring-buffer of entry-index of current scope at each sample.
+
+	unsigned int         overflow_names_used;
+	profsy_overflow_name overflow_names[PROFSY_OVERFLOW_NAMES_MAX];    // overflowed names in the order they were first seen.
+	uint16_t             overflow_lookup[PROFSY_OVERFLOW_LOOKUP_SIZE]; // open-addressed hash of overflow_names, 0 = empty, otherwise index + 1.
+};
+
+struct profsy_counter
+{
+	profsy_counter_data data;
+	uint64_t name_hash;
+	volatile uint64_t value; // current value as two's complement, counters are added to from any os-thread.
+};
+
+// an async span in flight, or a free slot.
+struct profsy_span
+{
+	const char*  name;
+	uint64_t     start;
+	unsigned int stats_index; // index in profsy_ctx::span_stats.
+	uint32_t     generation;  // incremented each time the slot is freed to invalidate old handles.
+	uint32_t     next_free;   // index + 1 of next free slot if this slot is free.
+};
+
+struct profsy_span_stats
+{
+	profsy_span_data data;
+
+	volatile uint64_t calls;
+	volatile uint64_t time;
+	volatile uint64_t max_time;
+};
+
+struct profsy_frame_domain
+{
+	profsy_frame_domain_data data;
+	uint64_t frame_start; // time when current frame in domain started.
 };
 
 struct profsy_ctx
 {
 	uint8_t* mem;
+	unsigned int generation; // unique id for each profsy_init(), used to invalidate cached ids.
 
 	profsy_thread* threads;
 	int threads_used;
@@ -70,17 +205,230 @@ struct profsy_ctx
 	unsigned int  entries_used;
 	unsigned int  entries_max;
 
-	uint64_t frame_start;
+	const profsy_scope_data** hierarchy; // all scopes flattened in depth-first order, updated when scopes are allocated.
+	unsigned int hierarchy_used;
+	unsigned int hierarchy_max;
+
+	profsy_name_data* names;        // scope-data aggregated per name over all call-paths.
+	uint64_t*         names_hash;   // hash of name for each item in names.
+	uint32_t*         names_index;  // open-addressed hash-table from name-hash to index in names, same size as path_index.
+	unsigned int      names_used;
+
+	uint32_t*    path_index;      // open-addressed hash-table from profsy_entry::path_hash to entry-index.
+	unsigned int path_index_mask; // size of path_index - 1, size is always a power of 2.
+
+	profsy_frame_domain domains[PROFSY_FRAME_DOMAINS_MAX];
+	int                 domains_used;
+
+	uint64_t      overhead;          // estimated ticks spent in profsy per scope, 0 if not calibrated.
+	profsy_entry* overhead_entry;    // built-in "profiler overhead"-scope or 0x0 if not calibrated.
+	bool          overhead_subtract; // true if overhead should be subtracted from published data.
+	uint64_t      overhead_budget;   // max estimated overhead per frame before scopes are switched to cheaper modes, 0 = no budget.
+	uint32_t*     budget_candidates; // scratch-space for profsy_apply_overhead_budget(), one slot per entry.
+
+	uint32_t trace_category_mask; // only scopes with category-bits in mask is added to trace.
+	unsigned int trace_max_depth;    // only scopes at this depth or less is added to trace, 0 = no limit.
+	uint64_t     trace_min_duration; // only scopes at least this long is added to trace, 0 = no limit.
+
+	uint64_t     trace_filters[PROFSY_TRACE_FILTER_SCOPES_MAX];         // path-hashes of scopes included or excluded from trace.
+	bool         trace_filters_include[PROFSY_TRACE_FILTER_SCOPES_MAX]; // true if corresponding scope in trace_filters is included.
+	unsigned int trace_filters_used;
+	unsigned int trace_includes_used;
+
+	profsy_counter counters[PROFSY_COUNTERS_MAX];
+	unsigned int   counters_used;
+
+	profsy_span       spans[PROFSY_SPANS_MAX];
+	volatile uint64_t spans_free;      // head of free-list, high 32 bits is an aba-tag and low is index + 1 of first free span.
+	profsy_span_stats span_stats[PROFSY_SPAN_NAMES_MAX];
+	unsigned int      span_stats_used;
+	volatile uint32_t span_stats_lock; // lock taken while registering new span-names.
+
+	volatile uint32_t register_lock; // lock taken while scopes and thread-ctx:s are registered, see profsy_register_lock().
 
 	profsy_trace_entry* trace_to_activate;
 	profsy_trace_entry* active_trace;
 	unsigned int max_active_trace;
-	unsigned int num_active_trace;
+	volatile uint32_t num_active_trace; // entries reserved in active_trace, reserved atomically as any thread can write to the trace.
 	unsigned int active_trace_frame;
 	unsigned int num_trace_frames;
 };
 
 static profsy_ctx* g_profsy_ctx;
+uint32_t g_profsy_category_mask = PROFSY_CATEGORY_ALL;
+static unsigned int g_profsy_generation;
+
+#if defined(_MSC_VER)
+	static bool profsy_atomic_cas64( volatile uint64_t* ptr, uint64_t expected, uint64_t desired ) { return (uint64_t)_InterlockedCompareExchange64( (volatile __int64*)ptr, (__int64)desired, (__int64)expected ) == expected; }
+	static void profsy_atomic_add64( volatile uint64_t* ptr, uint64_t value )                       { _InterlockedExchangeAdd64( (volatile __int64*)ptr, (__int64)value ); }
+	static bool profsy_atomic_cas32( volatile uint32_t* ptr, uint32_t expected, uint32_t desired ) { return (uint32_t)_InterlockedCompareExchange( (volatile long*)ptr, (long)desired, (long)expected ) == expected; }
+	static uint32_t profsy_atomic_add32( volatile uint32_t* ptr, uint32_t value )                    { return (uint32_t)_InterlockedExchangeAdd( (volatile long*)ptr, (long)value ); }
+	static uint64_t profsy_atomic_exchange64( volatile uint64_t* ptr, uint64_t value )               { return (uint64_t)_InterlockedExchange64( (volatile __int64*)ptr, (__int64)value ); }
+	static void profsy_memory_barrier()                                                              { _ReadWriteBarrier(); }
+#else
+	static bool profsy_atomic_cas64( volatile uint64_t* ptr, uint64_t expected, uint64_t desired ) { return __sync_bool_compare_and_swap( ptr, expected, desired ); }
+	static void profsy_atomic_add64( volatile uint64_t* ptr, uint64_t value )                       { __sync_fetch_and_add( ptr, value ); }
+	static bool profsy_atomic_cas32( volatile uint32_t* ptr, uint32_t expected, uint32_t desired ) { return __sync_bool_compare_and_swap( ptr, expected, desired ); }
+	static uint32_t profsy_atomic_add32( volatile uint32_t* ptr, uint32_t value )                    { return __sync_fetch_and_add( ptr, value ); }
+	static uint64_t profsy_atomic_exchange64( volatile uint64_t* ptr, uint64_t value )               { uint64_t old = 0, cur; while( ( cur = __sync_val_compare_and_swap( ptr, old, value ) ) != old ) old = cur; return old; }
+	static void profsy_memory_barrier()                                                              { __sync_synchronize(); }
+#endif
+
+// scopes can be registered from many os-threads at once, i.e. by the threads of a thread-group, and registering a
+// scope allocates entries, moves the shared hierarchy and adds to the path-index and name-table. All of that is
+// serialized by this lock, lookups of already registered scopes do not take it.
+static void profsy_register_lock( profsy_ctx* ctx )
+{
+	while( !profsy_atomic_cas32( &ctx->register_lock, 0, 1 ) ) {}
+}
+
+static void profsy_register_unlock( profsy_ctx* ctx )
+{
+	profsy_atomic_cas32( &ctx->register_lock, 1, 0 );
+}
+
+// ... the thread-id is read from the SIGPROF-handler, initial-exec tls is a plain read from the thread-pointer while
+// the default model in shared libraries might call __tls_get_addr() that is not async-signal-safe ...
+#if defined(_MSC_VER)
+	#define PROFSY_THREAD_LOCAL __declspec(thread)
+#elif defined(__GNUC__)
+	#define PROFSY_THREAD_LOCAL __thread __attribute__((tls_model("initial-exec")))
+#else
+	#define PROFSY_THREAD_LOCAL __thread
+#endif
+
+// id of the thread-ctx used by profsy_scope_enter/leave on the calling thread.
+static PROFSY_THREAD_LOCAL int g_profsy_thread_id = 0;
+
+static const uint32_t PROFSY_PATH_INDEX_EMPTY = 0xFFFFFFFF;
+static const char*    PROFSY_MAIN_THREAD_NAME = "main";
+static const uint64_t PROFSY_FNV1A_OFFSET = 0xcbf29ce484222325ULL;
+static const uint64_t PROFSY_FNV1A_PRIME  = 0x100000001b3ULL;
+
+static uint64_t profsy_hash_str( const char* str )
+{
+	uint64_t hash = PROFSY_FNV1A_OFFSET;
+	while( *str )
+		hash = ( hash ^ (uint8_t)*str++ ) * PROFSY_FNV1A_PRIME;
+	return hash;
+}
+
+static uint64_t profsy_hash_combine( uint64_t parent_hash, uint64_t name_hash )
+{
+	return parent_hash ^ ( name_hash + 0x9e3779b97f4a7c15ULL + ( parent_hash << 6 ) + ( parent_hash >> 2 ) );
+}
+
+static unsigned int profsy_path_index_size( const profsy_init_params* params )
+{
+	// keep load-factor below 0.5
+	unsigned int needed = ( params->entries_max + PROFSY_BUILTIN_SCOPES * params->threads_max ) * 2;
+	unsigned int size = 16;
+	while( size < needed )
+		size *= 2;
+	return size;
+}
+
+static const unsigned int PROFSY_NAME_INDEX_NONE = 0xFFFFFFFF;
+
+static unsigned int profsy_name_index( profsy_ctx* ctx, const char* name, uint64_t name_hash )
+{
+	unsigned int slot = (unsigned int)name_hash & ctx->path_index_mask;
+	while( ctx->names_index[slot] != PROFSY_PATH_INDEX_EMPTY )
+	{
+		// ... the hash only skips the string-compare, names that collide get a slot each ...
+		unsigned int index = ctx->names_index[slot];
+		if( ctx->names_hash[index] == name_hash && strcmp( ctx->names[index].name, name ) == 0 )
+			return index;
+		slot = ( slot + 1 ) & ctx->path_index_mask;
+	}
+
+	unsigned int index = ctx->names_used++;
+	ctx->names_index[slot]  = index;
+	ctx->names_hash[index]  = name_hash;
+	ctx->names[index].name  = name;
+	return index;
+}
+
+static unsigned int profsy_hierarchy_size( const profsy_init_params* params )
+{
+	// each entry shows up once, the overflow-scope of a thread only after its thread-tree, followed by its overflowed names.
+	return params->entries_max + PROFSY_BUILTIN_SCOPES * params->threads_max + params->threads_max * PROFSY_OVERFLOW_NAMES_MAX;
+}
+
+static bool profsy_hierarchy_insert( profsy_ctx* ctx, unsigned int pos, const profsy_scope_data* data )
+{
+	if( ctx->hierarchy_used >= ctx->hierarchy_max || pos > ctx->hierarchy_used )
+		return false;
+
+	memmove( ctx->hierarchy + pos + 1, ctx->hierarchy + pos, ( ctx->hierarchy_used - pos ) * sizeof( profsy_scope_data* ) );
+	ctx->hierarchy[pos] = data;
+	++ctx->hierarchy_used;
+
+	// ... only entries placed after pos moves, found by their data that is the first member of profsy_entry. Other
+	// items in the hierarchy is overflow-names that do not track their position. The position is assigned, not
+	// incremented, so an entry can never be moved past the end of the hierarchy ...
+	for( unsigned int i = pos + 1; i < ctx->hierarchy_used; ++i )
+	{
+		uintptr_t offset = (uintptr_t)ctx->hierarchy[i] - (uintptr_t)ctx->entries;
+		if( offset < ctx->entries_used * sizeof( profsy_entry ) )
+			ctx->entries[offset / sizeof( profsy_entry )].flat_index = i;
+	}
+	return true;
+}
+
+// insert data as the last child-scope of parent in the hierarchy, returns the position it was inserted at.
+static unsigned int profsy_hierarchy_insert_child( profsy_ctx* ctx, profsy_entry* parent, const profsy_scope_data* data )
+{
+	unsigned int pos = parent->flat_index + parent->flat_size;
+	if( profsy_hierarchy_insert( ctx, pos, data ) )
+		for( profsy_entry* p = parent; p != 0x0; p = p->parent )
+			++p->flat_size;
+	return pos;
+}
+
+static uint32_t* profsy_path_index_slot( profsy_ctx* ctx, uint64_t path_hash )
+{
+	unsigned int slot = (unsigned int)path_hash & ctx->path_index_mask;
+	while( ctx->path_index[slot] != PROFSY_PATH_INDEX_EMPTY && ctx->entries[ctx->path_index[slot]].path_hash != path_hash )
+		slot = ( slot + 1 ) & ctx->path_index_mask;
+	return ctx->path_index + slot;
+}
+
+static void profsy_path_index_insert( profsy_ctx* ctx, profsy_entry* entry )
+{
+	// ... only the first of two paths that collide is indexed. Lookups of children verify parent and name and fall back
+	// to search the children of the parent, profsy_find_scope_by_hash() can only find the first one ...
+	uint32_t* slot = profsy_path_index_slot( ctx, entry->path_hash );
+	if( *slot == PROFSY_PATH_INDEX_EMPTY )
+		*slot = (uint32_t)( entry - ctx->entries );
+}
+
+// find child-scope of parent with name, and its hash name_hash, in the path-index, 0x0 if not indexed.
+static profsy_entry* profsy_path_index_child( profsy_ctx* ctx, profsy_entry* parent, const char* name, uint64_t name_hash )
+{
+	uint32_t index = *profsy_path_index_slot( ctx, profsy_hash_combine( parent->path_hash, name_hash ) );
+	if( index == PROFSY_PATH_INDEX_EMPTY )
+		return 0x0;
+
+	profsy_entry* e = ctx->entries + index;
+	if( e->parent != parent || ( e->data.name != name && strcmp( e->data.name, name ) != 0 ) )
+		return 0x0;
+	return e;
+}
+
+// update if entry is included in trace from the filters set by profsy_trace_filter_scope(), the parent of entry
+// need to be up to date. The filter closest to entry in the hierarchy decides.
+static void profsy_trace_filter_update( profsy_ctx_t ctx, profsy_entry* entry )
+{
+	if( entry->parent != 0x0 )
+		entry->trace_included = entry->parent->trace_included;
+	else
+		entry->trace_included = ctx->trace_includes_used == 0;
+
+	for( unsigned int i = 0; i < ctx->trace_filters_used; ++i )
+		if( ctx->trace_filters[i] == entry->path_hash )
+			entry->trace_included = ctx->trace_filters_include[i];
+}
 
 static profsy_entry* profsy_alloc_entry( profsy_ctx_t ctx, int thread_id, const char* name )
 {
@@ -94,7 +442,30 @@ static profsy_entry* profsy_alloc_entry( profsy_ctx_t ctx, int thread_id, const
 	entry->next_child          = 0x0;
 	entry->calls               = 0;
 	entry->time                = 0;
+	entry->suspended_time      = 0;
+	entry->suspend_mark        = 0;
+	memset( entry->perf,      0x0, sizeof( entry->perf ) );
+	memset( entry->perf_mark, 0x0, sizeof( entry->perf_mark ) );
+	entry->flags               = 0;
+	entry->recursion_depth     = 0;
+	entry->context_switches    = 0;
+	entry->preempted           = 0;
+	entry->samples             = 0;
+	entry->data.mode           = PROFSY_SCOPE_MODE_FULL;
+	entry->data.category       = PROFSY_CATEGORY_DEFAULT;
+	entry->data.desc           = 0x0;
 	
+	entry->flat_index          = 0;
+	entry->flat_size           = 1;
+	entry->name_index          = PROFSY_NAME_INDEX_NONE;
+	entry->recursive           = false;
+	entry->trace_included      = true;
+	entry->merged              = 0x0;
+	entry->thread_id           = thread_id;
+	entry->name_hash           = profsy_hash_str( name );
+	entry->path_hash           = entry->name_hash;
+	entry->data.path_hash      = entry->path_hash;
+
 	entry->data.name           = name;
 	entry->data.depth          = 0;
 	entry->data.num_sub_scopes = 0;
@@ -104,10 +475,16 @@ static profsy_entry* profsy_alloc_entry( profsy_ctx_t ctx, int thread_id, const
 
 static int profsy_alloc_thread_ctx( profsy_ctx_t ctx, const char* thread_name )
 {
-	// ... !!! some lock here !!! ...
-	int thread_id = ctx->threads_used++;
-	if( thread_id >= ctx->threads_max )
+	// ... called with the register-lock taken, except from profsy_init() ...
+
+	// ... the root of a thread is hashed by name only, so two threads with the same name would share all paths ...
+	for( int i = 0; i < ctx->threads_used; ++i )
+		if( strcmp( ctx->threads[i].name, thread_name ) == 0 )
+			return -1;
+
+	if( ctx->threads_used >= ctx->threads_max )
 		return -1;
+	int thread_id = ctx->threads_used++;
 
 	// ... !!! embed some context id in threadid to be able to detect new ctx !!! ...
 	profsy_thread* thread = ctx->threads + thread_id;
@@ -115,10 +492,104 @@ static int profsy_alloc_thread_ctx( profsy_ctx_t ctx, const char* thread_name )
 	thread->root     = profsy_alloc_entry( ctx, thread_id, thread_name );
 	thread->overflow = profsy_alloc_entry( ctx, thread_id, "overflow scope" );
 	thread->overflow->parent = thread->root;
+	thread->overflow->data.depth = 1;
 	thread->current = thread->root;
+	thread->is_group = false;
+	thread->is_fiber = false;
+	thread->group_id = -1;
+	thread->domain_id = 0;
+	thread->perf_used = 0;
+	thread->trace_filtered = false;
+	thread->trace_pending_used    = 0;
+	thread->trace_pending_written = 0;
+	thread->sampling      = false;
+	thread->samples_write = 0;
+	thread->samples_read  = 0;
+	thread->suspended       = false;
+	thread->suspend_start   = 0;
+	thread->suspended_total = 0;
+
+	// the thread-tree is placed last in the hierarchy followed by the overflow-scope.
+	unsigned int flat_index = ctx->hierarchy_used;
+	profsy_hierarchy_insert( ctx, flat_index, &thread->root->data );
+	profsy_hierarchy_insert( ctx, flat_index + 1, &thread->overflow->data );
+	thread->root->flat_index     = flat_index;
+	thread->overflow->flat_index = flat_index + 1;
+
+	// the root is indexed by thread-name only, i.e. "<thread-name>/"
+	profsy_path_index_insert( ctx, thread->root );
+	profsy_trace_filter_update( ctx, thread->root );
+	profsy_trace_filter_update( ctx, thread->overflow );
 	return thread_id;
 }
 
+static profsy_entry* profsy_link_child_scope( profsy_ctx* ctx, int thread_id, profsy_entry* current, const char* name );
+static profsy_entry* profsy_get_child_scope( profsy_ctx* ctx, int thread_id, profsy_entry* parent, const char* name );
+
+// find or create the entry in the tree of a thread-group that has the same path as an entry in one of its threads.
+static profsy_entry* profsy_merged_child_scope( profsy_ctx* ctx, int group_id, profsy_entry* merged_parent, const char* name, uint64_t name_hash )
+{
+	profsy_entry* merged = profsy_path_index_child( ctx, merged_parent, name, name_hash );
+	if( merged == 0x0 )
+		merged = profsy_get_child_scope( ctx, group_id, merged_parent, name );
+	if( merged != 0x0 )
+		return merged;
+
+	merged = profsy_link_child_scope( ctx, group_id, merged_parent, name );
+	return merged == ctx->threads[group_id].overflow ? 0x0 : merged;
+}
+
+// alloc a new scope and link it as the last child of current.
+static profsy_entry* profsy_link_child_scope( profsy_ctx* ctx, int thread_id, profsy_entry* current, const char* name )
+{
+	profsy_thread* thread   = ctx->threads + thread_id;
+	profsy_entry*  overflow = thread->overflow;
+	profsy_entry*  e        = profsy_alloc_entry( ctx, thread_id, name );
+
+	// ... out of entries, the overflow-scope is not linked as a child, it is listed once after the thread-tree ...
+	if( e == overflow )
+		return e;
+
+	// insert at tail to get order where scopes was registered.
+	if( current->children )
+	{
+		profsy_entry* next = current->children;
+		while( next->next_child )
+			next = next->next_child;
+		next->next_child = e;
+	}
+	else
+		current->children = e;
+
+	e->data.depth = (uint16_t)(current->data.depth + 1);
+	e->parent = current;
+	e->path_hash = profsy_hash_combine( current->path_hash, e->name_hash );
+	e->data.path_hash = e->path_hash;
+	profsy_path_index_insert( ctx, e );
+	profsy_trace_filter_update( ctx, e );
+
+	// scopes in a thread-group is already accounted for in the threads of the group.
+	if( !thread->is_group )
+	{
+		e->name_index = profsy_name_index( ctx, name, e->name_hash );
+		for( profsy_entry* parent = current; parent != 0x0 && !e->recursive; parent = parent->parent )
+			e->recursive = parent->name_index == e->name_index;
+	}
+
+	profsy_entry* parent = e->parent;
+	while( parent != 0 )
+	{
+		parent->data.num_sub_scopes++;
+		parent = parent->parent;
+	}
+
+	e->flat_index = profsy_hierarchy_insert_child( ctx, current, &e->data );
+	if( thread->group_id >= 0 && current->merged != 0x0 )
+		e->merged = profsy_merged_child_scope( ctx, thread->group_id, current->merged, name, e->name_hash );
+
+	return e;
+}
+
 size_t profsy_calc_ctx_mem_usage( const profsy_init_params* params )
 {
 	size_t needed_mem = 16; // we add 16 bytes to be able to 16-align it
@@ -128,6 +599,14 @@ size_t profsy_calc_ctx_mem_usage( const profsy_init_params* params )
 	needed_mem += ( params->threads_max * sizeof( profsy_thread ) );
 	needed_mem  = ALIGN_UP( needed_mem, 16 );
 	needed_mem += ( params->entries_max + PROFSY_BUILTIN_SCOPES * params->threads_max ) * sizeof( profsy_entry ); // + 2 for "root" and "overflow"
+	needed_mem  = ALIGN_UP( needed_mem, 16 );
+	needed_mem += profsy_path_index_size( params ) * sizeof( uint32_t );
+	needed_mem  = ALIGN_UP( needed_mem, 16 );
+	needed_mem += profsy_hierarchy_size( params ) * sizeof( profsy_scope_data* );
+	needed_mem  = ALIGN_UP( needed_mem, 16 );
+	needed_mem += ( params->entries_max + PROFSY_BUILTIN_SCOPES * params->threads_max ) * ( sizeof( profsy_name_data ) + sizeof( uint64_t ) );
+	needed_mem += profsy_path_index_size( params ) * sizeof( uint32_t );
+	needed_mem += ( params->entries_max + PROFSY_BUILTIN_SCOPES * params->threads_max ) * sizeof( uint32_t );
 	
 	return needed_mem;
 }
@@ -151,11 +630,38 @@ void profsy_init( const profsy_init_params* params, uint8_t* in_mem )
 	ctx->entries      = ( profsy_entry* )mem;
 	ctx->entries_used = 0;
 	ctx->entries_max  = params->entries_max + PROFSY_BUILTIN_SCOPES;
+
+	mem = (uint8_t*)ALIGN_UP( mem + ( params->entries_max + PROFSY_BUILTIN_SCOPES * params->threads_max ) * sizeof( profsy_entry ), 16 );
+	ctx->path_index      = ( uint32_t* )mem;
+	ctx->path_index_mask = profsy_path_index_size( params ) - 1;
+
+	mem = (uint8_t*)ALIGN_UP( mem + ( ctx->path_index_mask + 1 ) * sizeof( uint32_t ), 16 );
+	ctx->hierarchy      = ( const profsy_scope_data** )mem;
+	ctx->hierarchy_used = 0;
+	ctx->hierarchy_max  = profsy_hierarchy_size( params );
+
+	mem = (uint8_t*)ALIGN_UP( mem + ctx->hierarchy_max * sizeof( profsy_scope_data* ), 16 );
+	ctx->names       = ( profsy_name_data* )mem;
+	mem += ( params->entries_max + PROFSY_BUILTIN_SCOPES * params->threads_max ) * sizeof( profsy_name_data );
+	ctx->names_hash  = ( uint64_t* )mem;
+	mem += ( params->entries_max + PROFSY_BUILTIN_SCOPES * params->threads_max ) * sizeof( uint64_t );
+	ctx->names_index = ( uint32_t* )mem;
+	ctx->names_used  = 0;
+	mem += ( ctx->path_index_mask + 1 ) * sizeof( uint32_t );
+	ctx->budget_candidates = ( uint32_t* )mem;
 	
 	memset( ctx->threads, 0x0, sizeof( profsy_thread ) * (size_t)ctx->threads_max );
 	memset( ctx->entries, 0x0, sizeof( profsy_entry )  * ctx->entries_max );
+	memset( ctx->path_index, 0xFF, sizeof( uint32_t ) * ( ctx->path_index_mask + 1 ) );
+	memset( ctx->names_index, 0xFF, sizeof( uint32_t ) * ( ctx->path_index_mask + 1 ) );
 
-	profsy_alloc_thread_ctx( ctx, "main" );
+	// ... trace-filters is evaluated as threads are allocated ...
+	ctx->trace_max_depth     = 0;
+	ctx->trace_min_duration  = 0;
+	ctx->trace_filters_used  = 0;
+	ctx->trace_includes_used = 0;
+
+	profsy_alloc_thread_ctx( ctx, PROFSY_MAIN_THREAD_NAME );
 
 	ctx->active_trace       = 0x0;
 	ctx->trace_to_activate  = 0x0;
@@ -164,13 +670,39 @@ void profsy_init( const profsy_init_params* params, uint8_t* in_mem )
 	ctx->active_trace_frame = 0;
 	ctx->num_trace_frames   = 0;
 
-	ctx->frame_start = PROFSY_CUSTOM_TICK_FUNC();
-	
+	ctx->counters_used = 0;
+
+	// all spans start out in the free-list.
+	for( unsigned int i = 0; i < PROFSY_SPANS_MAX; ++i )
+	{
+		ctx->spans[i].generation = 1;
+		ctx->spans[i].next_free  = i + 2 > PROFSY_SPANS_MAX ? 0 : i + 2;
+	}
+	ctx->spans_free      = 1;
+	ctx->span_stats_used = 0;
+	ctx->span_stats_lock = 0;
+	ctx->register_lock   = 0;
+	ctx->generation    = ++g_profsy_generation;
+
+	ctx->domains_used = 0;
+	ctx->overhead          = 0;
+	ctx->overhead_entry    = 0x0;
+	ctx->overhead_subtract = false;
+	ctx->overhead_budget   = 0;
+	ctx->trace_category_mask = PROFSY_CATEGORY_ALL;
 	g_profsy_ctx = ctx;
+
+	profsy_create_frame_domain( "main" );
 }
 
 uint8_t* profsy_shutdown()
 {
+	for( int i = 0; i < g_profsy_ctx->threads_used; ++i )
+	{
+		profsy_perf_counters_disable( i );
+		profsy_sampling_disable( i );
+	}
+
 	uint8_t* mem = g_profsy_ctx->mem;
 	g_profsy_ctx = 0x0;
 	return mem;
@@ -181,213 +713,1252 @@ profsy_ctx_t profsy_global_ctx()
 	return g_profsy_ctx;
 }
 
+const char* profsy_thread_name( int thread_ctx )
+{
+	profsy_ctx_t ctx = g_profsy_ctx;
+	if( ctx == 0x0 || thread_ctx < 0 || thread_ctx >= ctx->threads_used )
+		return 0x0;
+	return ctx->threads[thread_ctx].name;
+}
+
 int profsy_create_thread_ctx( const char* thread_name )
 {
 	profsy_ctx_t ctx = g_profsy_ctx;
 	if( ctx == 0x0 )
 		return -1;
 
-	// ... !!! some lock here !!! ...
-	int thread_id = ctx->threads_used++;
-	if( thread_id >= ctx->threads_max )
-		return -1;
-
-	profsy_thread* thread = ctx->threads + thread_id;
-	thread->name     = thread_name;
-	thread->root     = profsy_alloc_entry( ctx, thread_id, thread_name );
-	thread->overflow = profsy_alloc_entry( ctx, thread_id, "overflow scope" );
-	thread->overflow->parent = thread->root;
-	thread->current = thread->root;
-	return thread_id;
+	profsy_register_lock( ctx );
+	int thread_ctx = profsy_alloc_thread_ctx( ctx, thread_name );
+	profsy_register_unlock( ctx );
+	return thread_ctx;
 }
 
-// add functions to alloc scopes outside of macro
-
-static profsy_entry* profsy_get_child_scope( profsy_ctx* ctx, int thread_id, profsy_entry* parent, const char* name )
+int profsy_set_thread_ctx( int thread_ctx )
 {
-	profsy_entry* e = parent->children;
-	while( e > ctx->threads[thread_id].overflow && e->data.name != name )
-		e = e->next_child;
-	return e;
+	profsy_ctx_t ctx = g_profsy_ctx;
+	if( ctx == 0x0 || thread_ctx < 0 || thread_ctx >= ctx->threads_used || ctx->threads[thread_ctx].is_group )
+		return -1;
+
+	g_profsy_thread_id = thread_ctx;
+	return thread_ctx;
 }
 
-static void profsy_trace_add( profsy_ctx* ctx, uint64_t tick, uint16_t event, uint16_t scope_id )
+int profsy_create_fiber_ctx( const char* fiber_name )
 {
-	if( ctx->active_trace == 0x0 )
-		return; // ... no active trace!
-
-	unsigned int next_trace = ctx->num_active_trace++;
-	if( next_trace >= ctx->max_active_trace )
-		return; // ... no entries in trace-buffer left
+	profsy_ctx_t ctx = g_profsy_ctx;
+	if( ctx == 0x0 )
+		return -1;
 
-	profsy_trace_entry* te = ctx->active_trace + next_trace;
-	te->ts    = tick;
-	te->event = event;
-	te->scope = scope_id;
+	profsy_register_lock( ctx );
+	int fiber_ctx = profsy_alloc_thread_ctx( ctx, fiber_name );
+	if( fiber_ctx >= 0 )
+		ctx->threads[fiber_ctx].is_fiber = true;
+	profsy_register_unlock( ctx );
+	return fiber_ctx;
 }
 
-static void profsy_trace_close( profsy_ctx* ctx, uint64_t tick )
+int profsy_fiber_switch( int thread_ctx, uint64_t tick )
 {
-	unsigned int next_trace = ctx->num_active_trace++;
-	uint16_t event = PROFSY_TRACE_EVENT_END;
-	if( next_trace >= ctx->max_active_trace )
+	profsy_ctx_t ctx = g_profsy_ctx;
+	if( ctx == 0x0 || thread_ctx < 0 || thread_ctx >= ctx->threads_used || ctx->threads[thread_ctx].is_group )
+		return -1;
+
+	int prev_ctx = g_profsy_thread_id;
+	if( prev_ctx == thread_ctx )
+		return prev_ctx;
+
+	profsy_thread* prev = ctx->threads + prev_ctx;
+	if( prev->is_fiber )
 	{
-		next_trace = ctx->max_active_trace - 1;
-		event = PROFSY_TRACE_EVENT_OVERFLOW;
+		prev->suspended     = true;
+		prev->suspend_start = tick;
 	}
 
-	profsy_trace_entry* te = ctx->active_trace + next_trace;
-	te->ts    = tick;
-	te->event = event;
-	te->scope = (uint16_t)0;
+	profsy_thread* next = ctx->threads + thread_ctx;
+	if( next->suspended )
+	{
+		next->suspended        = false;
+		next->suspended_total += tick - next->suspend_start;
+	}
 
+	g_profsy_thread_id = thread_ctx;
+	return prev_ctx;
+}
 
-	ctx->active_trace = 0x0; // Trace is now done!
+int profsy_initialize_thread( const char* thread_name )
+{
+	return profsy_set_thread_ctx( profsy_create_thread_ctx( thread_name ) );
 }
 
-int profsy_scope_enter_thread( int thread_id, const char* name, uint64_t tick )
+int profsy_set_thread_group( int thread_ctx, const char* group_name )
 {
 	profsy_ctx_t ctx = g_profsy_ctx;
-
-	if( ctx == 0x0 )
+	if( ctx == 0x0 || thread_ctx < 0 || thread_ctx >= ctx->threads_used || ctx->threads[thread_ctx].is_group )
 		return -1;
 
-	profsy_entry* current  = ctx->threads[thread_id].current;
-	profsy_entry* overflow = ctx->threads[thread_id].overflow;
+	profsy_register_lock( ctx );
 
-	// search for scope in current open scope
-	profsy_entry* e = profsy_get_child_scope( ctx, thread_id, current, name );
+	int group_id = -1;
+	for( int i = 0; i < ctx->threads_used && group_id < 0; ++i )
+		if( ctx->threads[i].is_group && strcmp( ctx->threads[i].name, group_name ) == 0 )
+			group_id = i;
 
-	// not found!
-	if( e == 0x0 )
+	if( group_id < 0 )
 	{
-		// TODO: take lock here if multiple threads are to be supported
-
-		// search again since some other thread might have created the scope!
-		e = profsy_get_child_scope( ctx, thread_id, current, name );
-		if( e == 0x0 )
+		group_id = profsy_alloc_thread_ctx( ctx, group_name );
+		if( group_id < 0 )
 		{
-			// alloc scope and link
-			e = profsy_alloc_entry( ctx, thread_id, name );
-
-			// insert at tail to get order where scopes was registered.
-			if( current->children )
-			{
-				profsy_entry* next = current->children;
-				while( next->next_child )
-					next = next->next_child;
-				next->next_child = e;
-			}
-			else
-			{
-				if( current != overflow )
-					current->children = e;
-			}
-
-			if( e != overflow )
-			{
-				e->data.depth = (uint16_t)(current->data.depth + 1);
-				e->parent = current;
-
-				profsy_entry* parent = e->parent;
-				while( parent != 0 )
-				{
-					parent->data.num_sub_scopes++;
-					parent = parent->parent;
-				}
-			}
+			profsy_register_unlock( ctx );
+			return -1;
 		}
+		ctx->threads[group_id].is_group = true;
 	}
 
-	// count stuff
-	if( e != overflow )
-		ctx->threads[thread_id].current = e;
+	profsy_thread* thread = ctx->threads + thread_ctx;
+	if( thread->group_id == group_id )
+	{
+		profsy_register_unlock( ctx );
+		return group_id;
+	}
 
-	int scope_id = (int)(e - ctx->entries);
+	thread->group_id = group_id;
+	thread->root->merged     = ctx->threads[group_id].root;
+	thread->overflow->merged = ctx->threads[group_id].overflow;
 
-	// ... add trace if tracing
-	profsy_trace_add( ctx, tick, PROFSY_TRACE_EVENT_ENTER, (uint16_t)scope_id );
+	// merge all scopes already allocated in the thread, parents are always allocated before their children.
+	unsigned int entries_used = ctx->entries_used;
+	for( unsigned int i = 0; i < entries_used; ++i )
+	{
+		profsy_entry* e = ctx->entries + i;
+		if( e->thread_id == thread_ctx && e->parent != 0x0 && e != thread->overflow )
+			e->merged = e->parent->merged == 0x0 ? 0x0 : profsy_merged_child_scope( ctx, group_id, e->parent->merged, e->data.name, e->name_hash );
+	}
 
-	return scope_id;
+	profsy_register_unlock( ctx );
+	return group_id;
 }
 
-void profsy_scope_leave_thread( int thread_id, int scope_id, uint64_t start, uint64_t end )
+#if defined(__linux__)
+static int profsy_perf_event_open( uint32_t type, uint64_t config, int group_fd )
 {
-	profsy_ctx_t ctx = g_profsy_ctx;
-
-	if( ctx == 0x0 )
-		return;
+	struct perf_event_attr attr;
+	memset( &attr, 0x0, sizeof( attr ) );
+	attr.size           = sizeof( attr );
+	attr.type           = type;
+	attr.config         = config;
+	attr.read_format    = PERF_FORMAT_GROUP;
+	attr.exclude_kernel = 1;
+	attr.exclude_hv     = 1;
+	return (int)syscall( __NR_perf_event_open, &attr, 0, -1, group_fd, 0 );
+}
+#endif
 
-	profsy_entry* entry = ctx->entries + scope_id;
+int profsy_perf_counters_enable( int thread_ctx )
+{
+	profsy_ctx_t ctx = g_profsy_ctx;
+	if( ctx == 0x0 || thread_ctx < 0 || thread_ctx >= ctx->threads_used || ctx->threads[thread_ctx].is_group )
+		return -1;
 
-	uint64_t diff = end - start;
+#if defined(__linux__)
+	struct
+	{
+		uint32_t    type;
+		uint64_t    config;
+		const char* name;
+	} events[][2] = {
+		{ { PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS, "instructions" },  { PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS,       "page-faults" } },
+		{ { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES,   "cycles" },        { PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CPU_CLOCK,         "cpu-clock" } },
+		{ { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES, "cache-misses" },  { PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES, "context-switches" } },
+	};
+
+	profsy_perf_counters_disable( thread_ctx );
+
+	profsy_thread* thread = ctx->threads + thread_ctx;
+	for( unsigned int i = 0; i < sizeof( events ) / sizeof( events[0] ) && thread->perf_used < PROFSY_PERF_COUNTERS_MAX; ++i )
+	{
+		int group_fd = thread->perf_used == 0 ? -1 : thread->perf_fds[0];
+		for( unsigned int j = 0; j < 2; ++j )
+		{
+			int fd = profsy_perf_event_open( events[i][j].type, events[i][j].config, group_fd );
+			if( fd < 0 )
+				continue;
+
+			thread->perf_fds[thread->perf_used]   = fd;
+			thread->perf_names[thread->perf_used] = events[i][j].name;
+			++thread->perf_used;
+			break;
+		}
+	}
 
-	entry->calls += 1;
-	entry->time  += diff;
-	entry->parent->child_time += diff;
+	return thread->perf_used == 0 ? -1 : (int)thread->perf_used;
+#else
+	return -1;
+#endif
+}
 
-	ctx->threads[thread_id].current = entry->parent;
+void profsy_perf_counters_disable( int thread_ctx )
+{
+	profsy_ctx_t ctx = g_profsy_ctx;
+	if( ctx == 0x0 || thread_ctx < 0 || thread_ctx >= ctx->threads_used )
+		return;
 
-	// ... add trace if tracing
-	profsy_trace_add( ctx, end, PROFSY_TRACE_EVENT_LEAVE, (uint16_t)scope_id );
+	profsy_thread* thread = ctx->threads + thread_ctx;
+#if defined(__linux__)
+	// ... close group-members before leader ...
+	while( thread->perf_used > 0 )
+		close( thread->perf_fds[--thread->perf_used] );
+#else
+	thread->perf_used = 0;
+#endif
 }
 
-int profsy_scope_enter( const char* name, uint64_t tick )
+const char* profsy_perf_counter_name( int thread_ctx, unsigned int index )
 {
-	int thread_id = 0; // fetch this from a tls.
-	return profsy_scope_enter_thread( thread_id, name, tick );
+	profsy_ctx_t ctx = g_profsy_ctx;
+	if( ctx == 0x0 || thread_ctx < 0 || thread_ctx >= ctx->threads_used || index >= ctx->threads[thread_ctx].perf_used )
+		return 0x0;
+	return ctx->threads[thread_ctx].perf_names[index];
 }
 
-void profsy_scope_leave( int scope_id, uint64_t start, uint64_t end )
+// read all performance-counters of a thread with one read of the group-leader.
+static void profsy_perf_read( profsy_thread* thread, uint64_t* values )
 {
-	int thread_id = 0; // fetch this from a tls.
-	profsy_scope_leave_thread( thread_id, scope_id, start, end );
+#if defined(__linux__)
+	uint64_t group[1 + PROFSY_PERF_COUNTERS_MAX]; // nr followed by values.
+	if( read( thread->perf_fds[0], group, sizeof( group ) ) <= 0 )
+		return;
+	for( uint64_t i = 0; i < group[0] && i < PROFSY_PERF_COUNTERS_MAX; ++i )
+		values[i] = group[i + 1];
+#else
+	(void)thread; (void)values;
+#endif
 }
 
-void profsy_swap_frame()
+#if defined(__linux__)
+#if !defined( sigev_notify_thread_id )
+	#define sigev_notify_thread_id _sigev_un._tid
+#endif
+
+static void profsy_sample_handler( int /*signal*/, siginfo_t* /*info*/, void* /*uctx*/ )
 {
 	profsy_ctx_t ctx = g_profsy_ctx;
-	
 	if( ctx == 0x0 )
 		return;
 
-	for( int i = 0; i < ctx->threads_used; ++i )
-	{
+	// ... only the current-pointer is read here, it is always pointing to a valid entry ...
+	profsy_thread* thread = ctx->threads + g_profsy_thread_id;
+	uint32_t write = thread->samples_write;
+	if( write - thread->samples_read >= PROFSY_SAMPLES_MAX )
+		return; // ... ring is full, drop sample ...
+
+	thread->samples[write & ( PROFSY_SAMPLES_MAX - 1 )] = (uint32_t)( thread->current - ctx->entries );
+	profsy_memory_barrier();
+	thread->samples_write = write + 1;
+}
+#endif
+
+int profsy_sampling_enable( int thread_ctx, uint64_t interval_ns )
+{
+	profsy_ctx_t ctx = g_profsy_ctx;
+	if( ctx == 0x0 || thread_ctx < 0 || thread_ctx >= ctx->threads_used || ctx->threads[thread_ctx].is_group || interval_ns == 0 )
+		return -1;
+
+#if defined(__linux__)
+	// ... os-threads might enable sampling at the same time, the handler is only installed once under the register-lock ...
+	static bool handler_installed = false;
+	profsy_register_lock( ctx );
+	if( !handler_installed )
+	{
+		struct sigaction sa;
+		memset( &sa, 0x0, sizeof( sa ) );
+		sa.sa_sigaction = profsy_sample_handler;
+		sa.sa_flags     = SA_SIGINFO | SA_RESTART;
+		sigemptyset( &sa.sa_mask );
+		handler_installed = sigaction( SIGPROF, &sa, 0x0 ) == 0;
+	}
+	bool installed = handler_installed;
+	profsy_register_unlock( ctx );
+	if( !installed )
+		return -1;
+
+	profsy_sampling_disable( thread_ctx );
+
+	profsy_thread* thread = ctx->threads + thread_ctx;
+
+	struct sigevent sev;
+	memset( &sev, 0x0, sizeof( sev ) );
+	sev.sigev_notify           = SIGEV_THREAD_ID;
+	sev.sigev_signo            = SIGPROF;
+	sev.sigev_notify_thread_id = (pid_t)syscall( SYS_gettid );
+	if( timer_create( CLOCK_THREAD_CPUTIME_ID, &sev, &thread->sample_timer ) != 0 )
+		return -1;
+
+	struct itimerspec its;
+	its.it_interval.tv_sec  = (time_t)( interval_ns / 1000000000 );
+	its.it_interval.tv_nsec = (long)( interval_ns % 1000000000 );
+	its.it_value = its.it_interval;
+	if( timer_settime( thread->sample_timer, 0, &its, 0x0 ) != 0 )
+	{
+		timer_delete( thread->sample_timer );
+		return -1;
+	}
+
+	thread->sampling = true;
+	return 0;
+#else
+	return -1;
+#endif
+}
+
+// move all samples written by the signal-handler to the sampled entries.
+static void profsy_drain_samples( profsy_ctx* ctx, profsy_thread* thread )
+{
+	uint32_t read  = thread->samples_read;
+	uint32_t write = thread->samples_write;
+	profsy_memory_barrier();
+
+	for( ; read != write; ++read )
+		ctx->entries[thread->samples[read & ( PROFSY_SAMPLES_MAX - 1 )]].samples++;
+
+	profsy_memory_barrier();
+	thread->samples_read = read;
+}
+
+void profsy_sampling_disable( int thread_ctx )
+{
+	profsy_ctx_t ctx = g_profsy_ctx;
+	if( ctx == 0x0 || thread_ctx < 0 || thread_ctx >= ctx->threads_used || !ctx->threads[thread_ctx].sampling )
+		return;
+
+	profsy_thread* thread = ctx->threads + thread_ctx;
+#if defined(__linux__)
+	timer_delete( thread->sample_timer );
+#endif
+	thread->sampling = false;
+
+	// ... samples taken before the timer was stopped are kept in their scopes and the ring is left empty ...
+	profsy_drain_samples( ctx, thread );
+}
+
+static void profsy_sched_read( profsy_sched_info* info )
+{
+#if defined(__linux__)
+	struct rusage usage;
+	getrusage( RUSAGE_THREAD, &usage );
+	info->cpu                  = sched_getcpu();
+	info->voluntary_switches   = (uint64_t)usage.ru_nvcsw;
+	info->involuntary_switches = (uint64_t)usage.ru_nivcsw;
+#else
+	memset( info, 0x0, sizeof( profsy_sched_info ) );
+#endif
+}
+
+// add functions to alloc scopes outside of macro
+
+static profsy_entry* profsy_get_child_scope( profsy_ctx* ctx, int thread_id, profsy_entry* parent, const char* name )
+{
+	profsy_entry* e = parent->children;
+	while( e > ctx->threads[thread_id].overflow && e->data.name != name )
+		e = e->next_child;
+	return e;
+}
+
+static int profsy_overflow_name_index( profsy_ctx* ctx, int thread_id, const char* name )
+{
+	profsy_thread* thread = ctx->threads + thread_id;
+
+	unsigned int slot = (unsigned int)( ( (uintptr_t)name >> 3 ) * 2654435761u ) % PROFSY_OVERFLOW_LOOKUP_SIZE;
+
+	for( unsigned int probe = 0; probe < PROFSY_OVERFLOW_LOOKUP_SIZE; ++probe )
+	{
+		uint16_t index = thread->overflow_lookup[slot];
+		if( index == 0 )
+		{
+			if( thread->overflow_names_used >= PROFSY_OVERFLOW_NAMES_MAX )
+				return -1; // ... name-table is full, only count in overflow-scope.
+
+			profsy_overflow_name* on = thread->overflow_names + thread->overflow_names_used;
+			on->data.name  = name;
+			on->data.depth = (uint16_t)( thread->overflow->data.depth + 1 );
+			on->data.mode      = PROFSY_SCOPE_MODE_FULL;
+			on->data.desc      = 0x0;
+			on->data.path_hash = 0; // ... overflowed names are not tracked by path ...
+			thread->overflow_lookup[slot] = (uint16_t)++thread->overflow_names_used;
+			thread->overflow->data.num_sub_scopes = thread->overflow_names_used;
+
+			// ... overflowed names are listed right after the overflow-scope, clamped to never insert outside the hierarchy ...
+			profsy_register_lock( ctx );
+			unsigned int pos = thread->overflow->flat_index + thread->overflow_names_used;
+			if( pos > ctx->hierarchy_used )
+				pos = ctx->hierarchy_used;
+			profsy_hierarchy_insert( ctx, pos, &on->data );
+			profsy_register_unlock( ctx );
+			return (int)thread->overflow_names_used - 1;
+		}
+
+		if( thread->overflow_names[index - 1].data.name == name )
+			return index - 1;
+
+		slot = ( slot + 1 ) % PROFSY_OVERFLOW_LOOKUP_SIZE;
+	}
+
+	return -1;
+}
+
+// reserve count consecutive entries in the active trace, returns index of the first or max_active_trace if they do not
+// fit. Spans and flows are written from any os-thread so the reservation need to be atomic.
+static unsigned int profsy_trace_reserve( profsy_ctx* ctx, unsigned int count )
+{
+	unsigned int first = profsy_atomic_add32( &ctx->num_active_trace, count );
+	return first + count <= ctx->max_active_trace ? first : ctx->max_active_trace;
+}
+
+static void profsy_trace_set_arg( profsy_trace_entry* te, int thread_id, uint16_t arg_index, uint64_t value )
+{
+	te->arg    = value;
+	te->thread = (uint16_t)thread_id;
+	te->event  = PROFSY_TRACE_EVENT_ARG;
+	te->scope  = arg_index;
+}
+
+static void profsy_trace_write( profsy_ctx* ctx, int thread_id, uint64_t tick, uint16_t event, uint32_t scope_id )
+{
+	unsigned int next_trace = profsy_trace_reserve( ctx, 1 );
+	if( next_trace >= ctx->max_active_trace )
+		return; // ... no entries in trace-buffer left
+
+	profsy_trace_entry* te = ctx->active_trace + next_trace;
+	te->ts     = tick;
+	te->thread = (uint16_t)thread_id;
+	te->event  = event;
+	te->scope  = scope_id;
+}
+
+// write all scope-enters held back on thread to trace, called before any other event is written on the thread
+// as the enters need to come before it.
+static void profsy_trace_flush_pending( profsy_ctx* ctx, int thread_id )
+{
+	profsy_thread* thread = ctx->threads + thread_id;
+	for( ; thread->trace_pending_written < thread->trace_pending_used; ++thread->trace_pending_written )
+	{
+		profsy_trace_pending* p = thread->trace_pending + thread->trace_pending_written;
+		profsy_trace_write( ctx, thread_id, p->tick, PROFSY_TRACE_EVENT_ENTER, (uint32_t)p->scope_id );
+	}
+}
+
+static void profsy_trace_add( profsy_ctx* ctx, int thread_id, uint64_t tick, uint16_t event, uint32_t scope_id )
+{
+	if( ctx->active_trace == 0x0 )
+		return; // ... no active trace!
+
+	profsy_trace_flush_pending( ctx, thread_id );
+	profsy_trace_write( ctx, thread_id, tick, event, scope_id );
+}
+
+static void profsy_trace_add_arg( profsy_ctx* ctx, int thread_id, uint16_t arg_index, uint64_t value )
+{
+	if( ctx->active_trace == 0x0 )
+		return; // ... no active trace!
+
+	profsy_trace_flush_pending( ctx, thread_id );
+
+	unsigned int next_trace = profsy_trace_reserve( ctx, 1 );
+	if( next_trace >= ctx->max_active_trace )
+		return; // ... no entries in trace-buffer left
+
+	profsy_trace_set_arg( ctx->active_trace + next_trace, thread_id, arg_index, value );
+}
+
+// add event followed by num_args arguments. All entries are reserved at once so that events written by other
+// os-threads can not end up between the event and its arguments. Arguments are indexed 0 to num_args - 1 if
+// arg_indices is 0x0.
+static void profsy_trace_add_args( profsy_ctx* ctx, int thread_id, uint64_t tick, uint16_t event, uint32_t scope_id, const uint16_t* arg_indices, const uint64_t* args, unsigned int num_args )
+{
+	if( ctx->active_trace == 0x0 )
+		return; // ... no active trace!
+
+	profsy_trace_flush_pending( ctx, thread_id );
+
+	unsigned int next_trace = profsy_trace_reserve( ctx, 1 + num_args );
+	if( next_trace >= ctx->max_active_trace )
+		return; // ... no entries in trace-buffer left
+
+	profsy_trace_entry* te = ctx->active_trace + next_trace;
+	te->ts     = tick;
+	te->thread = (uint16_t)thread_id;
+	te->event  = event;
+	te->scope  = scope_id;
+	for( unsigned int i = 0; i < num_args; ++i )
+		profsy_trace_set_arg( ++te, thread_id, arg_indices != 0x0 ? arg_indices[i] : (uint16_t)i, args[i] );
+}
+
+// add event followed by its id-argument, if with_id, and its name-argument.
+static void profsy_trace_add_named( profsy_ctx* ctx, int thread_id, uint64_t tick, uint16_t event, const char* name, bool with_id, uint64_t id )
+{
+	uint16_t arg_indices[] = { 0, PROFSY_TRACE_ARG_NAME };
+	uint64_t args[]        = { id, (uint64_t)(uintptr_t)name };
+	unsigned int first = with_id ? 0 : 1;
+	profsy_trace_add_args( ctx, thread_id, tick, event, 0, arg_indices + first, args + first, 2 - first );
+}
+
+// true if scope in entry, registered with category, passes all trace-filters.
+static bool profsy_trace_scope_included( profsy_ctx* ctx, const profsy_entry* entry, uint32_t category )
+{
+	return ( category & ctx->trace_category_mask ) != 0
+		&& entry->trace_included
+		&& ( ctx->trace_max_depth == 0 || entry->data.depth <= ctx->trace_max_depth );
+}
+
+static void profsy_trace_scope_enter( profsy_ctx* ctx, int thread_id, uint64_t tick, int scope_id, const int64_t* args, unsigned int num_args )
+{
+	if( ctx->active_trace == 0x0 )
+		return; // ... no active trace!
+
+	// ... hold enter back until it is known if the scope is long enough, scopes nested to deep is always traced and
+	// so is scopes with arguments as arguments count as something traced while the scope is open ...
+	profsy_thread* thread = ctx->threads + thread_id;
+	if( ctx->trace_min_duration > 0 && num_args == 0 && thread->trace_pending_used < PROFSY_TRACE_PENDING_MAX )
+	{
+		profsy_trace_pending* p = thread->trace_pending + thread->trace_pending_used++;
+		p->tick     = tick;
+		p->scope_id = scope_id;
+		return;
+	}
+
+	profsy_trace_add_args( ctx, thread_id, tick, PROFSY_TRACE_EVENT_ENTER, (uint32_t)scope_id, 0x0, (const uint64_t*)args, num_args );
+}
+
+// add leave of scope_id followed by its arguments, arguments are dropped with the leave if the scope is to short.
+static void profsy_trace_scope_leave( profsy_ctx* ctx, int thread_id, uint64_t tick, int scope_id, const uint16_t* arg_indices, const uint64_t* args, unsigned int num_args )
+{
+	if( ctx->active_trace == 0x0 )
+		return; // ... no active trace!
+
+	profsy_thread* thread = ctx->threads + thread_id;
+	unsigned int   used   = thread->trace_pending_used;
+	if( used > 0 && thread->trace_pending[used - 1].scope_id == scope_id )
+	{
+		// ... scopes that nothing else was traced in while open is dropped if to short ...
+		profsy_trace_pending* p = thread->trace_pending + used - 1;
+		if( thread->trace_pending_written < used && tick - p->tick < ctx->trace_min_duration )
+		{
+			--thread->trace_pending_used;
+			return;
+		}
+
+		profsy_trace_flush_pending( ctx, thread_id );
+		--thread->trace_pending_used;
+		thread->trace_pending_written = thread->trace_pending_used;
+	}
+
+	profsy_trace_add_args( ctx, thread_id, tick, PROFSY_TRACE_EVENT_LEAVE, (uint32_t)scope_id, arg_indices, args, num_args );
+}
+
+static void profsy_trace_close( profsy_ctx* ctx, uint64_t tick )
+{
+	unsigned int next_trace = profsy_atomic_add32( &ctx->num_active_trace, 1 );
+	uint16_t event = PROFSY_TRACE_EVENT_END;
+	if( next_trace >= ctx->max_active_trace )
+	{
+		next_trace = ctx->max_active_trace - 1;
+		event = PROFSY_TRACE_EVENT_OVERFLOW;
+	}
+
+	profsy_trace_entry* te = ctx->active_trace + next_trace;
+	te->ts     = tick;
+	te->thread = 0;
+	te->event  = event;
+	te->scope  = 0;
+
+
+	ctx->active_trace = 0x0; // Trace is now done!
+}
+
+// find child-scope with name of desc in current scope of thread, registering it if not found.
+static profsy_entry* profsy_find_or_link_child_scope( profsy_ctx* ctx, int thread_id, const profsy_scope_desc* desc )
+{
+	const char* name = desc->name;
+	profsy_entry* current  = ctx->threads[thread_id].current;
+	profsy_entry* overflow = ctx->threads[thread_id].overflow;
+
+	// search for scope in current open scope
+	profsy_entry* e = profsy_get_child_scope( ctx, thread_id, current, name );
+
+	// not found!
+	if( e == 0x0 )
+	{
+		profsy_register_lock( ctx );
+
+		// search again since some other thread might have created the scope!
+		e = profsy_get_child_scope( ctx, thread_id, current, name );
+		if( e == 0x0 )
+		{
+			e = profsy_link_child_scope( ctx, thread_id, current, name );
+			if( e != overflow )
+			{
+				e->data.category = desc->category;
+				// ... descriptors without a call-site are built on the stack by the caller and can not be kept ...
+				e->data.desc     = desc->file != 0x0 ? desc : 0x0;
+			}
+		}
+
+		profsy_register_unlock( ctx );
+	}
+	return e;
+}
+
+
+static int profsy_scope_enter_internal( int thread_id, const profsy_scope_desc* desc, uint64_t tick, const int64_t* args, unsigned int num_args )
+{
+	profsy_ctx_t ctx = g_profsy_ctx;
+	const char* name = desc->name;
+
+	if( ctx == 0x0 )
+		return -1;
+
+	// ... collapsed recursion only counts depth, the scope is already current ...
+	profsy_entry* current = ctx->threads[thread_id].current;
+	if( ( current->flags & PROFSY_SCOPE_FLAG_COLLAPSE_RECURSION ) && current->data.name == name )
+	{
+		++current->recursion_depth;
+		int current_id = (int)( current - ctx->entries );
+		ctx->threads[thread_id].trace_filtered = !profsy_trace_scope_included( ctx, current, current->data.category );
+		if( !ctx->threads[thread_id].trace_filtered )
+			profsy_trace_scope_enter( ctx, thread_id, tick, current_id, args, num_args );
+		return current_id;
+	}
+
+	profsy_entry* overflow = ctx->threads[thread_id].overflow;
+	profsy_entry* e = desc->name_hash != 0 ? profsy_path_index_child( ctx, current, name, desc->name_hash ) : 0x0;
+	if( e == 0x0 )
+		e = profsy_find_or_link_child_scope( ctx, thread_id, desc );
+
+	// ... scopes switched to a cheaper mode are always leaves so current is not moved into them. No event is traced
+	// for them so arguments passed to profsy_trace_args() are dropped instead of attached to an earlier event ...
+	if( e->data.mode != PROFSY_SCOPE_MODE_FULL )
+	{
+		if( e->data.mode == PROFSY_SCOPE_MODE_COUNT_ONLY )
+			++e->calls;
+		ctx->threads[thread_id].trace_filtered = true;
+		return -1;
+	}
+
+	// count stuff
+	if( e != overflow )
+	{
+		ctx->threads[thread_id].current = e;
+		e->suspend_mark = ctx->threads[thread_id].suspended_total;
+		if( ctx->threads[thread_id].perf_used > 0 )
+			profsy_perf_read( ctx->threads + thread_id, e->perf_mark );
+		if( e->flags & PROFSY_SCOPE_FLAG_SCHED_INFO )
+			profsy_sched_read( &e->sched_mark );
+	}
+
+	int scope_id = (int)(e - ctx->entries);
+
+	// overflowed scopes get an id after all entries identifying its slot in the overflow name-table.
+	uint32_t trace_category = e->data.category;
+	if( e == overflow )
+	{
+		int name_index = profsy_overflow_name_index( ctx, thread_id, name );
+		if( name_index >= 0 )
+		{
+			scope_id = (int)ctx->entries_max + thread_id * (int)PROFSY_OVERFLOW_NAMES_MAX + name_index;
+			ctx->threads[thread_id].overflow_names[name_index].data.category = desc->category;
+			trace_category = desc->category;
+		}
+	}
+
+	// ... add trace if tracing
+	ctx->threads[thread_id].trace_filtered = !profsy_trace_scope_included( ctx, e, trace_category );
+	if( !ctx->threads[thread_id].trace_filtered )
+		profsy_trace_scope_enter( ctx, thread_id, tick, scope_id, args, num_args );
+
+	return scope_id;
+}
+
+// build a descriptor without call-site for the enter-functions that only get a name.
+static profsy_scope_desc profsy_scope_desc_make( const char* name, uint32_t category, uint64_t name_hash )
+{
+	profsy_scope_desc desc = { name, 0x0, 0x0, 0, category, name_hash };
+	return desc;
+}
+
+int profsy_scope_enter_thread( int thread_id, const char* name, uint64_t tick )
+{
+	profsy_scope_desc desc = profsy_scope_desc_make( name, PROFSY_CATEGORY_DEFAULT, 0 );
+	return profsy_scope_enter_internal( thread_id, &desc, tick, 0x0, 0 );
+}
+
+void profsy_scope_leave_thread( int thread_id, int scope_id, uint64_t start, uint64_t end )
+{
+	profsy_ctx_t ctx = g_profsy_ctx;
+
+	if( ctx == 0x0 || scope_id < 0 )
+		return;
+
+	profsy_thread* thread = ctx->threads + thread_id;
+	profsy_entry*  entry;
+
+	uint64_t diff = end - start;
+
+	profsy_sched_info sched;
+	bool preempted = false;
+	uint32_t trace_category = ctx->entries[scope_id < (int)ctx->entries_max ? scope_id : 0].data.category;
+
+	if( (unsigned int)scope_id >= ctx->entries_max )
+	{
+		profsy_overflow_name* on = thread->overflow_names + ( (unsigned int)scope_id - ctx->entries_max ) % PROFSY_OVERFLOW_NAMES_MAX;
+		on->calls += 1;
+		on->time  += diff;
+		entry = thread->overflow;
+		trace_category = on->data.category;
+	}
+	else
+	{
+		entry = ctx->entries + scope_id;
+
+		// ... time of collapsed recursion is already included in the outermost call ...
+		if( entry->recursion_depth > 0 )
+		{
+			--entry->recursion_depth;
+			entry->calls += 1;
+			if( profsy_trace_scope_included( ctx, entry, trace_category ) )
+				profsy_trace_scope_leave( ctx, thread_id, end, scope_id, 0x0, 0x0, 0 );
+			return;
+		}
+
+		// ... time when a fiber was detached from all os-threads is not spent in the scope ...
+		if( thread->is_fiber )
+		{
+			uint64_t suspended = thread->suspended_total - entry->suspend_mark;
+			entry->suspended_time += suspended;
+			diff -= suspended;
+		}
+
+		if( thread->perf_used > 0 )
+		{
+			uint64_t perf[PROFSY_PERF_COUNTERS_MAX];
+			memcpy( perf, entry->perf_mark, sizeof( perf ) );
+			profsy_perf_read( thread, perf );
+			for( unsigned int i = 0; i < thread->perf_used; ++i )
+				entry->perf[i] += perf[i] - entry->perf_mark[i];
+		}
+
+		if( entry->flags & PROFSY_SCOPE_FLAG_SCHED_INFO )
+		{
+			profsy_sched_read( &sched );
+			uint64_t voluntary   = sched.voluntary_switches   - entry->sched_mark.voluntary_switches;
+			uint64_t involuntary = sched.involuntary_switches - entry->sched_mark.involuntary_switches;
+			entry->context_switches += voluntary + involuntary;
+			preempted = involuntary > 0 || sched.cpu != entry->sched_mark.cpu;
+			if( preempted )
+				++entry->preempted;
+		}
+	}
+
+	entry->calls += 1;
+	entry->time  += diff;
+	entry->parent->child_time += diff;
+
+	// current is never moved into the overflow-scope so it should not be moved out of it either.
+	if( entry != thread->overflow )
+		thread->current = entry->parent;
+
+	// ... add trace if tracing
+	if( !profsy_trace_scope_included( ctx, entry, trace_category ) )
+		return;
+
+	uint16_t arg_indices[] = { PROFSY_TRACE_ARG_CPU, PROFSY_TRACE_ARG_CONTEXT_SWITCHES };
+	uint64_t args[]        = { 0, 0 };
+	if( preempted )
+	{
+		args[0] = (uint64_t)sched.cpu;
+		args[1] = sched.voluntary_switches + sched.involuntary_switches - entry->sched_mark.voluntary_switches - entry->sched_mark.involuntary_switches;
+	}
+	profsy_trace_scope_leave( ctx, thread_id, end, scope_id, arg_indices, args, preempted ? 2 : 0 );
+}
+
+int profsy_scope_enter( const char* name, uint64_t tick )
+{
+	return profsy_scope_enter_thread( g_profsy_thread_id, name, tick );
+}
+
+void profsy_scope_add( const char* name, uint64_t calls, uint64_t time )
+{
+	profsy_ctx_t ctx = g_profsy_ctx;
+	if( ctx == 0x0 )
+		return;
+
+	int thread_id = g_profsy_thread_id;
+	profsy_thread* thread = ctx->threads + thread_id;
+	profsy_scope_desc desc = profsy_scope_desc_make( name, PROFSY_CATEGORY_DEFAULT, 0 );
+	profsy_entry*  e      = profsy_find_or_link_child_scope( ctx, thread_id, &desc );
+
+	if( e == thread->overflow )
+	{
+		int name_index = profsy_overflow_name_index( ctx, thread_id, name );
+		if( name_index >= 0 )
+		{
+			thread->overflow_names[name_index].calls += calls;
+			thread->overflow_names[name_index].time  += time;
+		}
+	}
+	else if( e->data.mode != PROFSY_SCOPE_MODE_FULL )
+	{
+		if( e->data.mode == PROFSY_SCOPE_MODE_COUNT_ONLY )
+			e->calls += calls;
+		return;
+	}
+
+	e->calls += calls;
+	e->time  += time;
+	e->parent->child_time += time;
+}
+
+int profsy_scope_enter_category( const char* name, uint32_t category, uint64_t tick )
+{
+	profsy_scope_desc desc = profsy_scope_desc_make( name, category, 0 );
+	return profsy_scope_enter_internal( g_profsy_thread_id, &desc, tick, 0x0, 0 );
+}
+
+int profsy_scope_enter_hashed( const char* name, uint64_t name_hash, uint64_t tick )
+{
+	profsy_scope_desc desc = profsy_scope_desc_make( name, PROFSY_CATEGORY_DEFAULT, name_hash );
+	return profsy_scope_enter_internal( g_profsy_thread_id, &desc, tick, 0x0, 0 );
+}
+
+int profsy_scope_enter_desc( const profsy_scope_desc* desc, uint64_t tick )
+{
+	return profsy_scope_enter_internal( g_profsy_thread_id, desc, tick, 0x0, 0 );
+}
+
+int profsy_scope_enter_args( const profsy_scope_desc* desc, uint64_t tick, const int64_t* args, unsigned int num_args )
+{
+	return profsy_scope_enter_internal( g_profsy_thread_id, desc, tick, args, num_args );
+}
+
+void profsy_set_category_mask( uint32_t mask )
+{
+	g_profsy_category_mask = mask;
+}
+
+void profsy_set_trace_category_mask( uint32_t mask )
+{
+	profsy_ctx_t ctx = g_profsy_ctx;
+	if( ctx == 0x0 )
+		return;
+	ctx->trace_category_mask = mask;
+}
+
+void profsy_set_trace_max_depth( unsigned int max_depth )
+{
+	profsy_ctx_t ctx = g_profsy_ctx;
+	if( ctx == 0x0 )
+		return;
+	ctx->trace_max_depth = max_depth;
+}
+
+void profsy_set_trace_min_duration( uint64_t min_duration )
+{
+	profsy_ctx_t ctx = g_profsy_ctx;
+	if( ctx == 0x0 )
+		return;
+	ctx->trace_min_duration = min_duration;
+}
+
+// re-evaluate trace-filters for all entries, parents are always allocated before their children.
+static void profsy_trace_filter_update_all( profsy_ctx_t ctx )
+{
+	for( unsigned int i = 0; i < ctx->entries_used; ++i )
+		profsy_trace_filter_update( ctx, ctx->entries + i );
+}
+
+bool profsy_trace_filter_scope( uint64_t path_hash, bool include )
+{
+	profsy_ctx_t ctx = g_profsy_ctx;
+	if( ctx == 0x0 || ctx->trace_filters_used >= PROFSY_TRACE_FILTER_SCOPES_MAX )
+		return false;
+
+	ctx->trace_filters[ctx->trace_filters_used]         = path_hash;
+	ctx->trace_filters_include[ctx->trace_filters_used] = include;
+	++ctx->trace_filters_used;
+	if( include )
+		++ctx->trace_includes_used;
+	profsy_trace_filter_update_all( ctx );
+	return true;
+}
+
+void profsy_trace_clear_scope_filters()
+{
+	profsy_ctx_t ctx = g_profsy_ctx;
+	if( ctx == 0x0 )
+		return;
+
+	ctx->trace_filters_used  = 0;
+	ctx->trace_includes_used = 0;
+	profsy_trace_filter_update_all( ctx );
+}
+
+void profsy_scope_leave( int scope_id, uint64_t start, uint64_t end )
+{
+	profsy_scope_leave_thread( g_profsy_thread_id, scope_id, start, end );
+}
+
+// sum up published data from all threads in a thread-group into the scopes of the group, for all groups in domain.
+static void profsy_publish_merged( profsy_ctx* ctx, int domain_id )
+{
+	for( unsigned int i = 0; i < ctx->entries_used; ++i )
+	{
+		profsy_entry* e = ctx->entries + i;
+		if( e->merged == 0x0 || ctx->threads[e->merged->thread_id].domain_id != domain_id )
+			continue;
+
+		profsy_scope_data* md = &e->merged->data;
+		md->calls      += e->data.calls;
+		md->time       += e->data.time;
+		md->child_time += e->data.child_time;
+		for( unsigned int j = 0; j < PROFSY_PERF_COUNTERS_MAX; ++j )
+			md->perf_counters[j] += e->data.perf_counters[j];
+		md->context_switches += e->data.context_switches;
+		md->preempted        += e->data.preempted;
+		md->samples          += e->data.samples;
+		if( e->data.max_time > md->max_time )
+			md->max_time = e->data.max_time;
+	}
+}
+
+// sum up published data from all entries per name, recursive scopes are only counted once in time.
+static void profsy_publish_names( profsy_ctx* ctx )
+{
+	for( unsigned int i = 0; i < ctx->names_used; ++i )
+	{
+		profsy_name_data* nd = ctx->names + i;
+		nd->time = nd->self_time = nd->calls = 0;
+	}
+
+	for( unsigned int i = 0; i < ctx->entries_used; ++i )
+	{
+		profsy_entry* e = ctx->entries + i;
+		if( e->name_index == PROFSY_NAME_INDEX_NONE )
+			continue;
+
+		profsy_name_data* nd = ctx->names + e->name_index;
+		nd->calls     += e->data.calls;
+		// ... with overhead subtracted time can end up below child_time, clamp as in profsy_subtract_domain_overhead() ...
+		nd->self_time += e->data.time > e->data.child_time ? e->data.time - e->data.child_time : 0;
+		if( !e->recursive )
+			nd->time += e->data.time;
+	}
+}
+
+int profsy_create_frame_domain( const char* domain_name )
+{
+	profsy_ctx_t ctx = g_profsy_ctx;
+	if( ctx == 0x0 || ctx->domains_used >= PROFSY_FRAME_DOMAINS_MAX )
+		return -1;
+
+	profsy_frame_domain* domain = ctx->domains + ctx->domains_used;
+	domain->data.name   = domain_name;
+	domain->data.frames = 0;
+	domain->data.time   = 0;
+	domain->frame_start = PROFSY_CUSTOM_TICK_FUNC();
+	return ctx->domains_used++;
+}
+
+int profsy_set_thread_domain( int thread_ctx, int domain_id )
+{
+	profsy_ctx_t ctx = g_profsy_ctx;
+	if( ctx == 0x0 || thread_ctx < 0 || thread_ctx >= ctx->threads_used || domain_id < 0 || domain_id >= ctx->domains_used )
+		return -1;
+
+	ctx->threads[thread_ctx].domain_id = domain_id;
+	return domain_id;
+}
+
+const profsy_frame_domain_data* profsy_get_frame_domain_data( int domain_id )
+{
+	profsy_ctx_t ctx = g_profsy_ctx;
+	if( ctx == 0x0 || domain_id < 0 || domain_id >= ctx->domains_used )
+		return 0x0;
+	return &ctx->domains[domain_id].data;
+}
+
+// subtract estimated overhead of entering/leaving sub-scopes from the accumulated time of all scopes in domain.
+static void profsy_subtract_domain_overhead( profsy_ctx* ctx, int domain_id )
+{
+	for( unsigned int i = 0; i < ctx->entries_used; ++i )
+		ctx->entries[i].sub_calls = ctx->entries[i].child_calls = 0;
+
+	// ... children are always allocated after their parents so a reverse pass sums calls from leaves to root ...
+	for( unsigned int i = ctx->entries_used; i > 0; --i )
+	{
+		profsy_entry* e = ctx->entries + i - 1;
+		profsy_thread* thread = ctx->threads + e->thread_id;
+		if( thread->is_group || thread->domain_id != domain_id || e->parent == 0x0 )
+			continue; // ... groups are summed from already adjusted threads ...
+
+		// ... root-time is frame-time and is not adjusted ...
+		if( e->parent->parent != 0x0 )
+		{
+			e->parent->sub_calls   += e->calls + e->sub_calls;
+			e->parent->child_calls += e->calls;
+		}
+		else
+			e->parent->sub_calls += e->sub_calls; // ... only used for child_time of root ...
+
+		uint64_t time_overhead  = e->sub_calls * ctx->overhead;
+		uint64_t child_overhead = ( e->sub_calls - e->child_calls ) * ctx->overhead;
+		e->time       -= time_overhead  < e->time       ? time_overhead  : e->time;
+		e->child_time -= child_overhead < e->child_time ? child_overhead : e->child_time;
+	}
+
+	for( int i = 0; i < ctx->threads_used; ++i )
+	{
+		profsy_entry* root = ctx->threads[i].root;
+		if( ctx->threads[i].is_group || ctx->threads[i].domain_id != domain_id )
+			continue;
+		uint64_t child_overhead = root->sub_calls * ctx->overhead;
+		root->child_time -= child_overhead < root->child_time ? child_overhead : root->child_time;
+	}
+}
+
+static bool profsy_entry_can_change_mode( profsy_ctx* ctx, profsy_entry* e )
+{
+	profsy_thread* thread = ctx->threads + e->thread_id;
+	return e->children == 0x0 && e->parent != 0x0 && e != thread->overflow && e != ctx->overhead_entry && !thread->is_group;
+}
+
+// order candidates for profsy_apply_overhead_budget() by mode and then by most calls.
+static int profsy_budget_candidate_cmp( const void* a, const void* b )
+{
+	const profsy_entry* ea = g_profsy_ctx->entries + *(const uint32_t*)a;
+	const profsy_entry* eb = g_profsy_ctx->entries + *(const uint32_t*)b;
+	if( ea->data.mode != eb->data.mode )
+		return ea->data.mode < eb->data.mode ? -1 : 1;
+	if( ea->data.calls != eb->data.calls )
+		return ea->data.calls > eb->data.calls ? -1 : 1;
+	return ea < eb ? -1 : ( ea > eb ? 1 : 0 );
+}
+
+// switch e to the next cheaper mode and remove what it saves from estimate, each step saves about half the overhead.
+static void profsy_budget_switch_mode( profsy_ctx* ctx, profsy_entry* e, uint64_t* estimate )
+{
+	uint64_t saved = e->data.calls * ctx->overhead / 2;
+	*estimate -= saved < *estimate ? saved : *estimate;
+	e->data.mode = (uint16_t)( e->data.mode + 1 );
+}
+
+// switch the most called cheap leaf-scopes in domain to cheaper modes until the estimated overhead is within budget.
+static void profsy_apply_overhead_budget( profsy_ctx* ctx, int domain_id )
+{
+	// ... count-only scopes skip one tick and leave, estimate them at half the cost ...
+	uint64_t estimate = 0;
+	for( unsigned int i = 0; i < ctx->entries_used; ++i )
+	{
+		profsy_entry* e = ctx->entries + i;
+		if( ctx->threads[e->thread_id].domain_id != domain_id || ctx->threads[e->thread_id].is_group || e->parent == 0x0 )
+			continue;
+		if( e->data.mode == PROFSY_SCOPE_MODE_FULL )
+			estimate += e->data.calls * ctx->overhead;
+		else if( e->data.mode == PROFSY_SCOPE_MODE_COUNT_ONLY )
+			estimate += e->data.calls * ctx->overhead / 2;
+	}
+
+	if( estimate <= ctx->overhead_budget )
+		return;
+
+	uint32_t*    candidates     = ctx->budget_candidates;
+	unsigned int num_candidates = 0;
+	unsigned int num_full       = 0;
+	for( unsigned int i = 0; i < ctx->entries_used; ++i )
+	{
+		profsy_entry* e = ctx->entries + i;
+		if( ctx->threads[e->thread_id].domain_id != domain_id || !profsy_entry_can_change_mode( ctx, e ) || e->data.calls == 0 )
+			continue;
+
+		bool cheap = e->data.time <= e->data.calls * ctx->overhead;
+		if( e->data.mode == PROFSY_SCOPE_MODE_FULL && cheap )
+			++num_full;
+		else if( e->data.mode != PROFSY_SCOPE_MODE_COUNT_ONLY )
+			continue;
+		candidates[num_candidates++] = i;
+	}
+	qsort( candidates, num_candidates, sizeof( uint32_t ), profsy_budget_candidate_cmp );
+
+	// ... turn all cheap scopes to count-only, most called first, before turning any off ...
+	for( unsigned int i = 0; i < num_full && estimate > ctx->overhead_budget; ++i )
+		profsy_budget_switch_mode( ctx, ctx->entries + candidates[i], &estimate );
+
+	// ... the scopes just switched and the ones already count-only are both sorted by calls, merge them to turn off
+	// the most called first ...
+	unsigned int switched = 0;
+	unsigned int count    = num_full;
+	while( estimate > ctx->overhead_budget && ( switched < num_full || count < num_candidates ) )
+	{
+		bool take_switched = count >= num_candidates
+						  || ( switched < num_full && ctx->entries[candidates[switched]].data.calls >= ctx->entries[candidates[count]].data.calls );
+		uint32_t index = take_switched ? candidates[switched++] : candidates[count++];
+		profsy_budget_switch_mode( ctx, ctx->entries + index, &estimate );
+	}
+}
+
+// publish and reset all scopes of threads in domain.
+static void profsy_publish_domain( profsy_ctx* ctx, int domain_id )
+{
+	profsy_frame_domain* domain = ctx->domains + domain_id;
+	uint64_t frame_end = PROFSY_CUSTOM_TICK_FUNC();
+
+	for( int i = 0; i < ctx->threads_used; ++i )
+	{
+		if( ctx->threads[i].is_group || ctx->threads[i].domain_id != domain_id )
+			continue; // ... time in groups is the sum of its threads ...
 		ctx->threads[i].root->calls = 1; // TODO: TOK-Hack root to be one call
-		ctx->threads[i].root->time  = PROFSY_CUSTOM_TICK_FUNC() - ctx->frame_start; // TODO: TOK-Hack root to be one call
+		ctx->threads[i].root->time  = frame_end - domain->frame_start; // TODO: TOK-Hack root to be one call
+		profsy_drain_samples( ctx, ctx->threads + i );
 	}
 
+	if( ctx->overhead_subtract )
+		profsy_subtract_domain_overhead( ctx, domain_id );
+
+	uint64_t total_calls = 0;
 	for( unsigned int i = 0; i < ctx->entries_used; ++i )
 	{
 		profsy_entry* e    = ctx->entries + i;
+		if( ctx->threads[e->thread_id].domain_id != domain_id )
+			continue;
+
+		if( e->parent != 0x0 && !ctx->threads[e->thread_id].is_group )
+			total_calls += e->calls;
+
 		e->data.calls      = e->calls;
 		e->data.time       = e->time;
 		e->data.child_time = e->child_time;
+		e->data.max_time   = e->time;
+		e->data.suspended_time = e->suspended_time;
+		memcpy( e->data.perf_counters, e->perf, sizeof( e->perf ) );
+		memset( e->perf, 0x0, sizeof( e->perf ) );
+		e->data.context_switches = e->context_switches;
+		e->data.preempted        = e->preempted;
+		e->context_switches = e->preempted = 0;
+		e->data.samples = e->samples;
+		e->samples = 0;
+
+		e->calls = e->time = e->child_time = e->suspended_time = 0;
+	}
+
+	if( ctx->overhead_budget > 0 )
+		profsy_apply_overhead_budget( ctx, domain_id );
+
+	profsy_entry* overhead = ctx->overhead_entry;
+	if( overhead != 0x0 && ctx->threads[overhead->thread_id].domain_id == domain_id )
+	{
+		overhead->data.calls    = total_calls;
+		overhead->data.time     = total_calls * ctx->overhead;
+		overhead->data.max_time = overhead->data.time;
+	}
+
+	profsy_publish_merged( ctx, domain_id );
+	profsy_publish_names( ctx );
+
+	for( int i = 0; i < ctx->threads_used; ++i )
+	{
+		profsy_thread* thread = ctx->threads + i;
+		if( thread->domain_id != domain_id )
+			continue;
+
+		for( unsigned int j = 0; j < thread->overflow_names_used; ++j )
+		{
+			profsy_overflow_name* on = thread->overflow_names + j;
+			on->data.calls = on->calls;
+			on->data.time  = on->time;
+			on->calls = on->time = 0;
+		}
+	}
+
+	domain->data.frames++;
+	domain->data.time   = frame_end - domain->frame_start;
+	domain->frame_start = PROFSY_CUSTOM_TICK_FUNC();
+}
+
+void profsy_swap_domain( int domain_id )
+{
+	profsy_ctx_t ctx = g_profsy_ctx;
+	if( ctx == 0x0 || domain_id < 0 || domain_id >= ctx->domains_used )
+		return;
+
+	if( domain_id == 0 )
+		profsy_swap_frame();
+	else
+		profsy_publish_domain( ctx, domain_id );
+}
+
+void profsy_swap_frame()
+{
+	profsy_ctx_t ctx = g_profsy_ctx;
+	
+	if( ctx == 0x0 )
+		return;
+
+	profsy_publish_domain( ctx, 0 );
+
+	uint64_t frame_start = ctx->domains[0].frame_start;
 
-		e->calls = e->time = e->child_time = 0;
+	for( unsigned int i = 0; i < ctx->span_stats_used; ++i )
+	{
+		profsy_span_stats* stats = ctx->span_stats + i;
+		stats->data.calls    = stats->calls;
+		stats->data.time     = stats->time;
+		stats->data.max_time = stats->max_time;
+
+		// ... subtract what was published so that spans ending on other threads meanwhile are kept to next frame ...
+		profsy_atomic_add64( &stats->calls, 0 - stats->data.calls );
+		profsy_atomic_add64( &stats->time,  0 - stats->data.time );
+		profsy_atomic_cas64( &stats->max_time, stats->data.max_time, 0 );
 	}
 
-	ctx->frame_start = PROFSY_CUSTOM_TICK_FUNC();
+	for( unsigned int i = 0; i < ctx->counters_used; ++i )
+	{
+		profsy_counter* c = ctx->counters + i;
+
+		// ... read and reset in one operation so that adds from other threads meanwhile are kept to next frame ...
+		if( c->data.type == PROFSY_COUNTER_TYPE_COUNTER )
+			c->data.value = (int64_t)profsy_atomic_exchange64( &c->value, 0 );
+		else
+			c->data.value = (int64_t)c->value;
+
+		// ... add trace if tracing
+		uint16_t arg_index = 0;
+		uint64_t value     = (uint64_t)c->data.value;
+		profsy_trace_add_args( ctx, 0, frame_start, PROFSY_TRACE_EVENT_COUNTER, i, &arg_index, &value, 1 );
+	}
 
 	// ... add trace if tracing
-	profsy_trace_add( ctx, ctx->frame_start, PROFSY_TRACE_EVENT_LEAVE, (uint16_t)0 );
+	profsy_trace_add( ctx, 0, frame_start, PROFSY_TRACE_EVENT_LEAVE, 0 );
 
 	// if should start trace
 	if( ctx->trace_to_activate != 0x0 )
 	{
 		ctx->active_trace = ctx->trace_to_activate;
 		ctx->trace_to_activate = 0x0;
+
+		// ... enters held back by an earlier trace can not be written to this one ...
+		for( int i = 0; i < ctx->threads_used; ++i )
+		{
+			ctx->threads[i].trace_pending_used    = 0;
+			ctx->threads[i].trace_pending_written = 0;
+		}
 	}
 
 	// ... add trace if tracing
-	profsy_trace_add( ctx, ctx->frame_start, PROFSY_TRACE_EVENT_ENTER, (uint16_t)0 );
+	profsy_trace_add( ctx, 0, frame_start, PROFSY_TRACE_EVENT_ENTER, 0 );
 	
 	// if is tracing...
 	if( ctx->active_trace != 0x0 )
 	{
 		++ctx->active_trace_frame;
 		if( ctx->active_trace_frame > ctx->num_trace_frames )
-			profsy_trace_close( ctx, ctx->frame_start );
+			profsy_trace_close( ctx, frame_start );
 	}
 }
 
@@ -405,6 +1976,38 @@ void profsy_trace_begin( profsy_trace_entry* entries, unsigned int num_entries,
 	ctx->num_trace_frames   = frames_to_capture;
 }
 
+void profsy_instant( const char* name, uint64_t tick )
+{
+	profsy_ctx_t ctx = g_profsy_ctx;
+	if( ctx == 0x0 || ctx->active_trace == 0x0 )
+		return;
+
+	profsy_trace_add_named( ctx, g_profsy_thread_id, tick, PROFSY_TRACE_EVENT_INSTANT, name, false, 0 );
+}
+
+void profsy_trace_args( const int64_t* args, unsigned int num_args )
+{
+	profsy_ctx_t ctx = g_profsy_ctx;
+	if( ctx == 0x0 || ctx->active_trace == 0x0 || ctx->threads[g_profsy_thread_id].trace_filtered )
+		return;
+
+	for( unsigned int i = 0; i < num_args; ++i )
+		profsy_trace_add_arg( ctx, g_profsy_thread_id, (uint16_t)i, (uint64_t)args[i] );
+}
+
+static void profsy_flow_add( uint16_t event, const char* name, uint64_t flow_id, uint64_t tick )
+{
+	profsy_ctx_t ctx = g_profsy_ctx;
+	if( ctx == 0x0 || ctx->active_trace == 0x0 )
+		return;
+
+	profsy_trace_add_named( ctx, g_profsy_thread_id, tick, event, name, true, flow_id );
+}
+
+void profsy_flow_begin( const char* name, uint64_t flow_id, uint64_t tick ) { profsy_flow_add( PROFSY_TRACE_EVENT_FLOW_BEGIN, name, flow_id, tick ); }
+void profsy_flow_step ( const char* name, uint64_t flow_id, uint64_t tick ) { profsy_flow_add( PROFSY_TRACE_EVENT_FLOW_STEP,  name, flow_id, tick ); }
+void profsy_flow_end  ( const char* name, uint64_t flow_id, uint64_t tick ) { profsy_flow_add( PROFSY_TRACE_EVENT_FLOW_END,   name, flow_id, tick ); }
+
 bool profsy_is_tracing()
 {
 	profsy_ctx_t ctx = g_profsy_ctx;
@@ -414,79 +2017,418 @@ bool profsy_is_tracing()
 unsigned int profsy_max_active_scopes() { return g_profsy_ctx == 0x0 ? 0 : g_profsy_ctx->entries_max; }
 unsigned int profsy_num_active_scopes() { return g_profsy_ctx == 0x0 ? 0 : g_profsy_ctx->entries_used; }
 
-int profsy_find_scope( const char* scope_path )
+static int profsy_span_stats_index( profsy_ctx* ctx, const char* name )
+{
+	for( unsigned int i = 0; i < ctx->span_stats_used; ++i )
+		if( ctx->span_stats[i].data.name == name )
+			return (int)i;
+
+	// ... first time name is seen, register it under lock and search again by content ...
+	while( !profsy_atomic_cas32( &ctx->span_stats_lock, 0, 1 ) ) {}
+
+	int index = -1;
+	for( unsigned int i = 0; i < ctx->span_stats_used && index < 0; ++i )
+		if( strcmp( ctx->span_stats[i].data.name, name ) == 0 )
+			index = (int)i;
+
+	if( index < 0 && ctx->span_stats_used < PROFSY_SPAN_NAMES_MAX )
+	{
+		profsy_span_stats* stats = ctx->span_stats + ctx->span_stats_used;
+		memset( stats, 0x0, sizeof( profsy_span_stats ) );
+		stats->data.name = name;
+		index = (int)ctx->span_stats_used++;
+	}
+
+	ctx->span_stats_lock = 0;
+	return index;
+}
+
+profsy_span_t profsy_span_begin( const char* name, uint64_t tick )
+{
+	profsy_ctx_t ctx = g_profsy_ctx;
+	if( ctx == 0x0 )
+		return 0;
+
+	int stats_index = profsy_span_stats_index( ctx, name );
+	if( stats_index < 0 )
+		return 0;
+
+	// pop span from free-list
+	uint64_t head;
+	uint32_t index;
+	do
+	{
+		head  = ctx->spans_free;
+		index = (uint32_t)head;
+		if( index == 0 )
+			return 0; // ... no free spans ...
+	}
+	while( !profsy_atomic_cas64( &ctx->spans_free, head, ( ( ( head >> 32 ) + 1 ) << 32 ) | ctx->spans[index - 1].next_free ) );
+
+	profsy_span* span = ctx->spans + index - 1;
+	span->name        = name;
+	span->start       = tick;
+	span->stats_index = (unsigned int)stats_index;
+
+	profsy_span_t handle = ( (uint64_t)span->generation << 32 ) | index;
+
+	// ... add trace if tracing
+	profsy_trace_add_named( ctx, g_profsy_thread_id, tick, PROFSY_TRACE_EVENT_SPAN_BEGIN, name, true, handle );
+
+	return handle;
+}
+
+void profsy_span_end( profsy_span_t handle, uint64_t tick )
+{
+	profsy_ctx_t ctx = g_profsy_ctx;
+	uint32_t index = (uint32_t)handle;
+	if( ctx == 0x0 || index == 0 || index > PROFSY_SPANS_MAX )
+		return;
+
+	profsy_span* span = ctx->spans + index - 1;
+	uint32_t generation = (uint32_t)( handle >> 32 );
+	if( !profsy_atomic_cas32( &span->generation, generation, generation + 1 ) )
+		return; // ... span already ended ...
+
+	uint64_t diff = tick - span->start;
+
+	profsy_span_stats* stats = ctx->span_stats + span->stats_index;
+	profsy_atomic_add64( &stats->calls, 1 );
+	profsy_atomic_add64( &stats->time,  diff );
+	for( uint64_t max_time = stats->max_time; diff > max_time; max_time = stats->max_time )
+		if( profsy_atomic_cas64( &stats->max_time, max_time, diff ) )
+			break;
+
+	// ... add trace if tracing
+	profsy_trace_add_named( ctx, g_profsy_thread_id, tick, PROFSY_TRACE_EVENT_SPAN_END, span->name, true, handle );
+
+	// push span to free-list
+	uint64_t head;
+	do
+	{
+		head = ctx->spans_free;
+		span->next_free = (uint32_t)head;
+	}
+	while( !profsy_atomic_cas64( &ctx->spans_free, head, ( ( ( head >> 32 ) + 1 ) << 32 ) | index ) );
+}
+
+unsigned int profsy_get_span_data( const profsy_span_data** spans, unsigned int num_spans )
+{
+	profsy_ctx_t ctx = g_profsy_ctx;
+	if( ctx == 0x0 )
+		return 0;
+
+	unsigned int num_items = ctx->span_stats_used < num_spans ? ctx->span_stats_used : num_spans;
+	for( unsigned int i = 0; i < num_items; ++i )
+		spans[i] = &ctx->span_stats[i].data;
+	return num_items;
+}
+
+int profsy_counter_register( const char* name, uint16_t type )
 {
 	profsy_ctx_t ctx = g_profsy_ctx;
 	if( ctx == 0x0 )
 		return -1;
 
-	int thread_id = 0; // pass to function or name root-scope to <thread_name>?
+	profsy_register_lock( ctx );
+
+	// ... the hash only skips the string-compare, names that collide are still kept apart ...
+	int counter_id = -1;
+	uint64_t name_hash = profsy_hash_str( name );
+	for( unsigned int i = 0; i < ctx->counters_used && counter_id < 0; ++i )
+		if( ctx->counters[i].name_hash == name_hash && strcmp( ctx->counters[i].data.name, name ) == 0 )
+			counter_id = (int)i;
+
+	if( counter_id < 0 && ctx->counters_used < PROFSY_COUNTERS_MAX )
+	{
+		profsy_counter* c = ctx->counters + ctx->counters_used;
+		c->data.name  = name;
+		c->data.value = 0;
+		c->data.type  = type;
+		c->name_hash  = name_hash;
+		c->value      = 0;
+		counter_id = (int)ctx->counters_used++;
+	}
+
+	profsy_register_unlock( ctx );
+	return counter_id;
+}
+
+void profsy_counter_add( int counter_id, int64_t value )
+{
+	profsy_ctx_t ctx = g_profsy_ctx;
+	if( ctx == 0x0 || (unsigned int)counter_id >= ctx->counters_used )
+		return;
+	profsy_atomic_add64( &ctx->counters[counter_id].value, (uint64_t)value );
+}
+
+void profsy_gauge_set( int counter_id, int64_t value )
+{
+	profsy_ctx_t ctx = g_profsy_ctx;
+	if( ctx == 0x0 || (unsigned int)counter_id >= ctx->counters_used )
+		return;
+	profsy_atomic_exchange64( &ctx->counters[counter_id].value, (uint64_t)value );
+}
 
-	if( *scope_path == '\0' )
-		return (int)( ctx->threads[thread_id].root - ctx->entries );
+profsy_counter_data* profsy_get_counter_data( int counter_id )
+{
+	profsy_ctx_t ctx = g_profsy_ctx;
+	if( ctx == 0x0 || (unsigned int)counter_id >= ctx->counters_used )
+		return 0x0;
+	return &ctx->counters[counter_id].data;
+}
 
-	const char* search = scope_path;
-	const char* end    = search + strlen( search );
+unsigned int profsy_num_counters() { return g_profsy_ctx == 0x0 ? 0 : g_profsy_ctx->counters_used; }
 
-	profsy_entry* e = ctx->threads[thread_id].root;
+static profsy_counter* profsy_counter_from_site( __profsy_counter_site* site )
+{
+	profsy_ctx_t ctx = g_profsy_ctx;
+	if( ctx == 0x0 )
+		return 0x0;
 
-	while( search < end )
+	// ... only lookup counter by name the first time the site is used with this context. Threads racing on the first
+	// use all register the same name and get the same id, the id is written before the generation that publish it ...
+	if( site->generation != ctx->generation )
 	{
-		const char* dot = strchr( search, '.' );
-		if( dot == 0x0 )
-			dot = end;
+		site->counter_id = profsy_counter_register( site->name, site->type );
+		profsy_memory_barrier();
+		site->generation = ctx->generation;
+	}
+	profsy_memory_barrier();
+
+	return site->counter_id < 0 ? 0x0 : ctx->counters + site->counter_id;
+}
 
-		profsy_entry* found = 0x0;
+void __profsy_counter_add( __profsy_counter_site* site, int64_t value )
+{
+	profsy_counter* c = profsy_counter_from_site( site );
+	if( c != 0x0 )
+		profsy_atomic_add64( &c->value, (uint64_t)value );
+}
 
-		for( profsy_entry* child = e->children; child != 0x0 && found == 0x0; child = child->next_child )
-			if( strncmp( child->data.name, search, (size_t)( dot - search ) ) == 0 )
-				found = child;
+void __profsy_gauge_set( __profsy_counter_site* site, int64_t value )
+{
+	profsy_counter* c = profsy_counter_from_site( site );
+	if( c != 0x0 )
+		profsy_atomic_exchange64( &c->value, (uint64_t)value );
+}
 
-		if( found == 0x0 )
-			return -1;
+uint64_t profsy_path_hash( const char* scope_path )
+{
+	// hash the path in the same way as profsy_path_index_insert() does while entries are allocated,
+	// paths without a thread-prefix is relative to the root of the first thread.
+	uint64_t path_hash    = profsy_hash_str( PROFSY_MAIN_THREAD_NAME );
+	uint64_t segment_hash = PROFSY_FNV1A_OFFSET;
+	bool     in_segment   = false;
 
-		e = found;
-		search = dot + 1;
+	for( const char* c = scope_path; *c != '\0'; ++c )
+	{
+		switch( *c )
+		{
+			case '.':
+				path_hash    = profsy_hash_combine( path_hash, segment_hash );
+				segment_hash = PROFSY_FNV1A_OFFSET;
+				in_segment   = false;
+				break;
+			case '/':
+				path_hash    = segment_hash; // the root of a thread is hashed by name only.
+				segment_hash = PROFSY_FNV1A_OFFSET;
+				in_segment   = false;
+				break;
+			default:
+				segment_hash = ( segment_hash ^ (uint8_t)*c ) * PROFSY_FNV1A_PRIME;
+				in_segment   = true;
+				break;
+		}
 	}
 
-	return (int)( e - ctx->entries );
+	if( in_segment )
+		path_hash = profsy_hash_combine( path_hash, segment_hash );
+	return path_hash;
+}
+
+int profsy_find_scope_by_hash( uint64_t path_hash )
+{
+	profsy_ctx_t ctx = g_profsy_ctx;
+	if( ctx == 0x0 )
+		return -1;
+
+	uint32_t index = *profsy_path_index_slot( ctx, path_hash );
+	return index == PROFSY_PATH_INDEX_EMPTY ? -1 : (int)index;
+}
+
+int profsy_find_scope( const char* scope_path )
+{
+	return profsy_find_scope_by_hash( profsy_path_hash( scope_path ) );
 }
 
 profsy_scope_data* profsy_get_scope_data( int scope_id )
 {
 	profsy_ctx_t ctx = g_profsy_ctx;
 
-	if( ctx == 0x0 || (unsigned int)scope_id >= ctx->entries_max )
+	if( ctx == 0x0 || scope_id < 0 )
+		return 0x0;
+
+	if( (unsigned int)scope_id < ctx->entries_max )
+		return &ctx->entries[scope_id].data;
+
+	unsigned int overflow_id = (unsigned int)scope_id - ctx->entries_max;
+	unsigned int thread_id   = overflow_id / PROFSY_OVERFLOW_NAMES_MAX;
+	if( thread_id >= (unsigned int)ctx->threads_used )
 		return 0x0;
 
-	return &ctx->entries[scope_id].data;
+	return &ctx->threads[thread_id].overflow_names[overflow_id % PROFSY_OVERFLOW_NAMES_MAX].data;
+}
+
+uint64_t profsy_calibrate_overhead( unsigned int iterations )
+{
+	profsy_ctx_t ctx = g_profsy_ctx;
+	if( ctx == 0x0 || iterations == 0 )
+		return 0;
+
+	static const char* OVERHEAD_SCOPE_NAME = "profiler overhead";
+
+	int thread_id = g_profsy_thread_id;
+	profsy_entry* parent = ctx->threads[thread_id].current;
+
+	// ... measure the same work as PROFSY_SCOPE does, two ticks and one enter/leave ...
+	uint64_t start = PROFSY_CUSTOM_TICK_FUNC();
+	int scope_id = -1;
+	for( unsigned int i = 0; i < iterations; ++i )
+	{
+		uint64_t scope_start = PROFSY_CUSTOM_TICK_FUNC();
+		scope_id = profsy_scope_enter_thread( thread_id, OVERHEAD_SCOPE_NAME, scope_start );
+		profsy_scope_leave_thread( thread_id, scope_id, scope_start, PROFSY_CUSTOM_TICK_FUNC() );
+	}
+	uint64_t end = PROFSY_CUSTOM_TICK_FUNC();
+
+	ctx->overhead = ( end - start ) / iterations;
+
+	// ... the calibration-loop itself should not be reported ...
+	profsy_entry* e = (unsigned int)scope_id < ctx->entries_max ? ctx->entries + scope_id : ctx->threads[thread_id].overflow;
+	if( e != ctx->threads[thread_id].overflow )
+	{
+		parent->child_time -= e->time;
+		e->calls = e->time = 0;
+		ctx->overhead_entry = e;
+	}
+
+	return ctx->overhead;
 }
 
-static void profsy_append_hierarchy( const profsy_entry* entry, const profsy_scope_data** child_scopes, unsigned int* num_child_scopes )
+void profsy_set_overhead_budget( uint64_t ticks_per_frame )
 {
-	child_scopes[(*num_child_scopes)++] = &entry->data;
+	profsy_ctx_t ctx = g_profsy_ctx;
+	if( ctx == 0x0 )
+		return;
+	ctx->overhead_budget = ticks_per_frame;
+}
+
+int profsy_set_scope_mode( int scope_id, uint16_t mode )
+{
+	profsy_ctx_t ctx = g_profsy_ctx;
+	if( ctx == 0x0 || scope_id < 0 || (unsigned int)scope_id >= ctx->entries_used || mode > PROFSY_SCOPE_MODE_OFF )
+		return -1;
 
-	for( profsy_entry* child = entry->children;
-		 child != 0x0;
-		 child = child->next_child )
-		profsy_append_hierarchy( child, child_scopes, num_child_scopes );
+	profsy_entry* e = ctx->entries + scope_id;
+	if( mode != PROFSY_SCOPE_MODE_FULL && !profsy_entry_can_change_mode( ctx, e ) )
+		return -1;
+
+	e->data.mode = mode;
+	return 0;
 }
 
-void profsy_get_scope_hierarchy( const profsy_scope_data** child_scopes, unsigned int /*num_child_scopes*/ )
+void profsy_subtract_overhead( bool enable )
 {
 	profsy_ctx_t ctx = g_profsy_ctx;
-	
 	if( ctx == 0x0 )
 		return;
+	ctx->overhead_subtract = enable;
+}
 
-	uint32_t thread_start = 0;
+int profsy_set_scope_flags( int scope_id, uint32_t flags )
+{
+	profsy_ctx_t ctx = g_profsy_ctx;
+	if( ctx == 0x0 || scope_id < 0 || (unsigned int)scope_id >= ctx->entries_used )
+		return -1;
 
-	for( int i = 0; i < ctx->threads_used; ++i )
+	ctx->entries[scope_id].flags = flags;
+	return 0;
+}
+
+uint32_t profsy_get_scope_flags( int scope_id )
+{
+	profsy_ctx_t ctx = g_profsy_ctx;
+	if( ctx == 0x0 || scope_id < 0 || (unsigned int)scope_id >= ctx->entries_used )
+		return 0;
+	return ctx->entries[scope_id].flags;
+}
+
+unsigned int profsy_get_overflow_scopes( int thread_id, const profsy_scope_data** scopes, unsigned int num_scopes )
+{
+	profsy_ctx_t ctx = g_profsy_ctx;
+
+	if( ctx == 0x0 || thread_id < 0 || thread_id >= ctx->threads_used )
+		return 0;
+
+	profsy_thread* thread = ctx->threads + thread_id;
+	unsigned int num_names = thread->overflow_names_used < num_scopes ? thread->overflow_names_used : num_scopes;
+	for( unsigned int i = 0; i < num_names; ++i )
+		scopes[i] = &thread->overflow_names[i].data;
+	return num_names;
+}
+
+unsigned int profsy_get_scope_hierarchy( const profsy_scope_data** child_scopes, unsigned int num_child_scopes )
+{
+	profsy_ctx_t ctx = g_profsy_ctx;
+	
+	if( ctx == 0x0 )
+		return 0;
+
+	unsigned int num_scopes = ctx->hierarchy_used < num_child_scopes ? ctx->hierarchy_used : num_child_scopes;
+	memcpy( child_scopes, ctx->hierarchy, num_scopes * sizeof( profsy_scope_data* ) );
+	return num_scopes;
+}
+
+unsigned int profsy_get_name_data( const profsy_name_data** names, unsigned int num_names )
+{
+	profsy_ctx_t ctx = g_profsy_ctx;
+
+	if( ctx == 0x0 )
+		return 0;
+
+	unsigned int num_items = ctx->names_used < num_names ? ctx->names_used : num_names;
+	for( unsigned int i = 0; i < num_items; ++i )
+		names[i] = ctx->names + i;
+	return num_items;
+}
+
+unsigned int profsy_get_thread_hierarchy( int thread_ctx, const profsy_scope_data** child_scopes, unsigned int num_child_scopes )
+{
+	profsy_ctx_t ctx = g_profsy_ctx;
+
+	if( ctx == 0x0 || thread_ctx < 0 || thread_ctx >= ctx->threads_used )
+		return 0;
+
+	// the scopes of a thread are its root-tree followed by the overflow-scope and all overflowed names.
+	profsy_thread* thread   = ctx->threads + thread_ctx;
+	unsigned int num_scopes = thread->root->flat_size + 1 + thread->overflow_names_used;
+	if( num_scopes > num_child_scopes )
+		num_scopes = num_child_scopes;
+	memcpy( child_scopes, ctx->hierarchy + thread->root->flat_index, num_scopes * sizeof( profsy_scope_data* ) );
+	return num_scopes;
+}
+
+const profsy_scope_data* const* profsy_scope_hierarchy( unsigned int* num_scopes )
+{
+	profsy_ctx_t ctx = g_profsy_ctx;
+
+	if( ctx == 0x0 )
 	{
-		uint32_t curr_scope = 0;
-		profsy_thread* thread = ctx->threads + i;
-		profsy_append_hierarchy( thread->root, child_scopes + thread_start, &curr_scope );
-		child_scopes[thread_start + curr_scope] = &thread->overflow->data;
-		thread_start += curr_scope + 1;
+		*num_scopes = 0;
+		return 0x0;
 	}
+
+	*num_scopes = ctx->hierarchy_used;
+	return ctx->hierarchy;
 }
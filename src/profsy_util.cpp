@@ -26,6 +26,9 @@
 
 #include <profsy/profsy_util.h>
 
+#include <stdarg.h>
+#include <string.h>
+
 #if defined(__GNUC__)
 #  include <unistd.h>
 #elif defined(_MSC_VER)
@@ -37,11 +40,49 @@
 static const char PROFSY_CHROME_TRACE_ENTRY[] =
 	PROFSY_STRINGIFY( { "cat":"profsy",
 						"pid":%d,
-						"tid":"main",
+						"tid":"%s",
 						"ts":%lu,
 						"ph":"%c",
 						"name":"%s",
-						"args":{} } );
+						"args":{ );
+
+static const char PROFSY_CHROME_INSTANT_ENTRY[] =
+	PROFSY_STRINGIFY( { "cat":"profsy",
+						"pid":%d,
+						"tid":"%s",
+						"ts":%lu,
+						"ph":"i",
+						"s":"t",
+						"name":"%s",
+						"args":{ );
+
+static const char PROFSY_CHROME_COUNTER_ENTRY[] =
+	PROFSY_STRINGIFY( { "cat":"profsy",
+						"pid":%d,
+						"tid":"%s",
+						"ts":%lu,
+						"ph":"C",
+						"name":"%s",
+						"args":{ "value":%lld } } );
+
+static const char PROFSY_CHROME_FLOW_ENTRY[] =
+	PROFSY_STRINGIFY( { "cat":"profsy",
+						"pid":%d,
+						"tid":"%s",
+						"ts":%lu,
+						"ph":"%c",
+						"id":%llu,
+						"name":"%s",
+						"bp":"e" } );
+
+static const char PROFSY_CHROME_ASYNC_ENTRY[] =
+	PROFSY_STRINGIFY( { "cat":"profsy",
+						"pid":%d,
+						"tid":"%s",
+						"ts":%lu,
+						"ph":"%c",
+						"id":%llu,
+						"name":"%s" } );
 
 static int profsy_getpid()
 {
@@ -54,45 +95,887 @@ static int profsy_getpid()
 #endif
 }
 
-static void profsy_util_dump_text( FILE* s, profsy_trace_entry* entries )
+/**
+ * size of the buffer that output is collected in before it is sent to the dump-callback in
+ * PROFSY_UTIL_DUMP_MODE_CHUNK, also the max size of one line in the text-based formats.
+ */
+#if !defined( PROFSY_UTIL_CHUNK_SIZE )
+	#define PROFSY_UTIL_CHUNK_SIZE 8192
+#endif
+
+// output of all dump-formats, collected in a buffer and sent to callback in chunks or lines.
+struct profsy_writer
+{
+	void ( *callback )( const uint8_t* data, size_t byte_count, void* userdata );
+	void*        userdata;
+	unsigned int mode;
+	size_t       used;
+	uint8_t      buffer[PROFSY_UTIL_CHUNK_SIZE];
+};
+
+static void profsy_writer_flush( profsy_writer* w )
+{
+	if( w->used > 0 )
+		w->callback( w->buffer, w->used, w->userdata );
+	w->used = 0;
+}
+
+// mark the end of a line or packet, sent to callback directly in PROFSY_UTIL_DUMP_MODE_LINE.
+static void profsy_writer_end_record( profsy_writer* w )
 {
+	if( w->mode == PROFSY_UTIL_DUMP_MODE_LINE )
+		profsy_writer_flush( w );
 }
 
-static void profsy_util_dump_chrome( FILE* s, profsy_trace_entry* entries )
+static void profsy_writer_write( profsy_writer* w, const void* data, size_t size )
+{
+	const uint8_t* src = (const uint8_t*)data;
+	while( size > 0 )
+	{
+		if( w->used == sizeof( w->buffer ) )
+			profsy_writer_flush( w );
+
+		size_t to_copy = sizeof( w->buffer ) - w->used;
+		if( to_copy > size )
+			to_copy = size;
+		memcpy( w->buffer + w->used, src, to_copy );
+		w->used += to_copy;
+		src     += to_copy;
+		size    -= to_copy;
+	}
+}
+
+static void profsy_writer_putc( profsy_writer* w, char c )
+{
+	profsy_writer_write( w, &c, 1 );
+}
+
+#if defined(__GNUC__)
+static void profsy_writer_printf( profsy_writer* w, const char* fmt, ... ) __attribute__(( format( printf, 2, 3 ) ));
+#endif
+
+// printf to writer, output longer than PROFSY_UTIL_CHUNK_SIZE is truncated.
+static void profsy_writer_printf( profsy_writer* w, const char* fmt, ... )
+{
+	char line[PROFSY_UTIL_CHUNK_SIZE];
+	va_list args;
+	va_start( args, fmt );
+	int len = vsnprintf( line, sizeof( line ), fmt, args );
+	va_end( args );
+	if( len <= 0 )
+		return;
+
+	size_t size = (size_t)len < sizeof( line ) ? (size_t)len : sizeof( line ) - 1;
+	profsy_writer_write( w, line, size );
+	if( line[size - 1] == '\n' )
+		profsy_writer_end_record( w );
+}
+
+static void profsy_writer_init( profsy_writer* w, unsigned int mode, void ( *callback )( const uint8_t*, size_t, void* ), void* userdata )
+{
+	w->callback = callback;
+	w->userdata = userdata;
+	w->mode     = mode;
+	w->used     = 0;
+}
+
+static void profsy_writer_stream_callback( const uint8_t* data, size_t byte_count, void* userdata )
+{
+	fwrite( data, 1, byte_count, (FILE*)userdata );
+}
+
+static bool profsy_trace_entry_is_end( const profsy_trace_entry* e )
+{
+	return e->event == PROFSY_TRACE_EVENT_END || e->event == PROFSY_TRACE_EVENT_OVERFLOW;
+}
+
+// return the argument to event e that follows arg, pass e as arg to get the first one, or 0x0 if there is none.
+// Only arguments written by the thread of the event belong to it.
+static const profsy_trace_entry* profsy_trace_entry_next_arg( const profsy_trace_entry* e, const profsy_trace_entry* arg )
+{
+	++arg;
+	return arg->event == PROFSY_TRACE_EVENT_ARG && arg->thread == e->thread ? arg : 0x0;
+}
+
+// return the value of argument arg_index to event e, or 0 if it is not present.
+static uint64_t profsy_trace_entry_arg( const profsy_trace_entry* e, uint16_t arg_index )
+{
+	for( const profsy_trace_entry* arg = profsy_trace_entry_next_arg( e, e ); arg != 0x0; arg = profsy_trace_entry_next_arg( e, arg ) )
+		if( arg->scope == arg_index )
+			return arg->arg;
+	return 0;
+}
+
+// return the lowest thread-id in trace that is higher than after, or -1 if there is none.
+static int profsy_trace_next_thread( const profsy_trace_entry* entries, int after )
+{
+	int next = -1;
+	for( const profsy_trace_entry* e = entries; !profsy_trace_entry_is_end( e ); ++e )
+		if( (int)e->thread > after && ( next < 0 || (int)e->thread < next ) )
+			next = (int)e->thread;
+	return next;
+}
+
+// write all arguments to event e as chrome-args and close the event.
+static void profsy_chrome_write_args( profsy_writer* s, const profsy_trace_entry* e, const char* separator )
+{
+	for( const profsy_trace_entry* arg = profsy_trace_entry_next_arg( e, e ); arg != 0x0; arg = profsy_trace_entry_next_arg( e, arg ) )
+	{
+		switch( arg->scope )
+		{
+			case PROFSY_TRACE_ARG_NAME:
+				continue;
+			case PROFSY_TRACE_ARG_CPU:
+				profsy_writer_printf( s, "%s\"cpu\":%lld", separator, (long long)arg->arg );
+				break;
+			case PROFSY_TRACE_ARG_CONTEXT_SWITCHES:
+				profsy_writer_printf( s, "%s\"context_switches\":%lld", separator, (long long)arg->arg );
+				break;
+			default:
+				profsy_writer_printf( s, "%s\"arg%u\":%lld", separator, (unsigned int)arg->scope, (long long)arg->arg );
+				break;
+		}
+		separator = ", ";
+	}
+	profsy_writer_printf( s, "} }" );
+}
+
+// write str as a json-string, escaping quotes and backslashes as in windows-paths.
+static void profsy_chrome_write_string( profsy_writer* s, const char* str )
+{
+	profsy_writer_putc( s, '"' );
+	for( ; *str != '\0'; ++str )
+	{
+		if( *str == '"' || *str == '\\' )
+			profsy_writer_putc( s, '\\' );
+		profsy_writer_putc( s, *str );
+	}
+	profsy_writer_putc( s, '"' );
+}
+
+static const char* profsy_chrome_thread_name( const profsy_trace_entry* e )
+{
+	const char* name = profsy_thread_name( (int)e->thread );
+	return name == 0x0 ? "" : name;
+}
+
+static char profsy_chrome_flow_phase( uint16_t event )
+{
+	switch( event )
+	{
+		case PROFSY_TRACE_EVENT_FLOW_BEGIN: return 's';
+		case PROFSY_TRACE_EVENT_FLOW_STEP:  return 't';
+		default:                            return 'f';
+	}
+}
+
+static void profsy_util_dump_chrome( profsy_writer* s, profsy_trace_entry* entries )
 {
 	int pid = profsy_getpid();
 
-	fprintf( s, "{ \"traceEvents\" : [\n" );
+	profsy_writer_printf( s, "{ \"traceEvents\" : [\n" );
 
-	profsy_trace_entry* e = entries;
-	while( e->event < PROFSY_TRACE_EVENT_END )
+	const char* separator = "";
+	for( profsy_trace_entry* e = entries; !profsy_trace_entry_is_end( e ); ++e )
 	{
-		profsy_scope_data* data = profsy_get_scope_data( (int)e->scope );
-		fprintf( s, PROFSY_CHROME_TRACE_ENTRY,
-					pid,
-				    e->ts / 1000,
-				    e->event == PROFSY_TRACE_EVENT_ENTER ? 'B' : 'E',
-				    data->name );
-		++e;
-		if( e->event < PROFSY_TRACE_EVENT_END )
-			fprintf( s, ",\n" );
+		switch( e->event )
+		{
+			case PROFSY_TRACE_EVENT_ENTER:
+			case PROFSY_TRACE_EVENT_LEAVE:
+			{
+				profsy_scope_data* data = profsy_get_scope_data( (int)e->scope );
+				profsy_writer_printf( s, "%s", separator );
+				profsy_writer_printf( s, PROFSY_CHROME_TRACE_ENTRY,
+							pid,
+							profsy_chrome_thread_name( e ),
+							e->ts / 1000,
+							e->event == PROFSY_TRACE_EVENT_ENTER ? 'B' : 'E',
+							data->name );
+
+				// ... path-hash is stable between runs and can be used to match scopes between captures ...
+				const char* arg_separator = "";
+				if( e->event == PROFSY_TRACE_EVENT_ENTER && data->path_hash != 0 )
+				{
+					profsy_writer_printf( s, "\"path_hash\":\"%016llx\"", (unsigned long long)data->path_hash );
+					arg_separator = ", ";
+				}
+				// ... source-location of the call-site that registered the scope, if any ...
+				if( e->event == PROFSY_TRACE_EVENT_ENTER && data->desc != 0x0 )
+				{
+					profsy_writer_printf( s, "%s\"file\":", arg_separator );
+					profsy_chrome_write_string( s, data->desc->file );
+					profsy_writer_printf( s, ", \"line\":%u", (unsigned int)data->desc->line );
+					arg_separator = ", ";
+				}
+				profsy_chrome_write_args( s, e, arg_separator );
+			}
+			break;
+			case PROFSY_TRACE_EVENT_INSTANT:
+			{
+				const char* name = (const char*)(uintptr_t)profsy_trace_entry_arg( e, PROFSY_TRACE_ARG_NAME );
+				profsy_writer_printf( s, "%s", separator );
+				profsy_writer_printf( s, PROFSY_CHROME_INSTANT_ENTRY,
+							pid,
+							profsy_chrome_thread_name( e ),
+							e->ts / 1000,
+							name ? name : "" );
+				profsy_chrome_write_args( s, e, "" );
+			}
+			break;
+			case PROFSY_TRACE_EVENT_FLOW_BEGIN:
+			case PROFSY_TRACE_EVENT_FLOW_STEP:
+			case PROFSY_TRACE_EVENT_FLOW_END:
+			{
+				const char* name = (const char*)(uintptr_t)profsy_trace_entry_arg( e, PROFSY_TRACE_ARG_NAME );
+				profsy_writer_printf( s, "%s", separator );
+				profsy_writer_printf( s, PROFSY_CHROME_FLOW_ENTRY,
+							pid,
+							profsy_chrome_thread_name( e ),
+							e->ts / 1000,
+							profsy_chrome_flow_phase( e->event ),
+							(unsigned long long)profsy_trace_entry_arg( e, 0 ),
+							name ? name : "" );
+			}
+			break;
+			case PROFSY_TRACE_EVENT_SPAN_BEGIN:
+			case PROFSY_TRACE_EVENT_SPAN_END:
+			{
+				const char* name = (const char*)(uintptr_t)profsy_trace_entry_arg( e, PROFSY_TRACE_ARG_NAME );
+				profsy_writer_printf( s, "%s", separator );
+				profsy_writer_printf( s, PROFSY_CHROME_ASYNC_ENTRY,
+							pid,
+							profsy_chrome_thread_name( e ),
+							e->ts / 1000,
+							e->event == PROFSY_TRACE_EVENT_SPAN_BEGIN ? 'b' : 'e',
+							(unsigned long long)profsy_trace_entry_arg( e, 0 ),
+							name ? name : "" );
+			}
+			break;
+			case PROFSY_TRACE_EVENT_COUNTER:
+			{
+				profsy_counter_data* data = profsy_get_counter_data( (int)e->scope );
+				profsy_writer_printf( s, "%s", separator );
+				profsy_writer_printf( s, PROFSY_CHROME_COUNTER_ENTRY,
+							pid,
+							profsy_chrome_thread_name( e ),
+							e->ts / 1000,
+							data->name,
+							(long long)profsy_trace_entry_arg( e, 0 ) );
+			}
+			break;
+			default:
+				continue; // ... arguments are written together with the event they belong to ...
+		}
+		separator = ",\n";
 	}
 
-	fprintf( s, "\n] }\n" );
+	profsy_writer_printf( s, "\n] }\n" );
 }
 
-void profsy_util_dump_to_stream( FILE* s, profsy_trace_entry* entries, unsigned int format )
+// max depth and length of a stack in the folded-format, deeper scopes are folded into their parent.
+static const unsigned int PROFSY_FOLDED_DEPTH_MAX = 256;
+static const unsigned int PROFSY_FOLDED_PATH_MAX  = 4096;
+
+// stack of scopes in the folded-format, the path is built incrementally as ";"-separated names as scopes are pushed.
+struct profsy_folded_stack
+{
+	char         path[PROFSY_FOLDED_PATH_MAX];
+	unsigned int length[PROFSY_FOLDED_DEPTH_MAX];     // length of path at each depth.
+	uint64_t     time[PROFSY_FOLDED_DEPTH_MAX];       // enter-time of scope when dumping a trace, total time when dumping a tree.
+	uint64_t     child_time[PROFSY_FOLDED_DEPTH_MAX]; // time spent in child-scopes.
+	unsigned int depth;    // number of names in path.
+	unsigned int overflow; // number of scopes pushed while the stack was full.
+};
+
+// push name to stack, ';' is replaced as it separates names in the folded-format.
+static bool profsy_folded_push( profsy_folded_stack* stack, const char* name, uint64_t time )
+{
+	if( stack->depth >= PROFSY_FOLDED_DEPTH_MAX )
+	{
+		++stack->overflow;
+		return false;
+	}
+
+	unsigned int len = stack->depth == 0 ? 0 : stack->length[stack->depth - 1];
+	if( stack->depth > 0 && len < PROFSY_FOLDED_PATH_MAX - 1 )
+		stack->path[len++] = ';';
+	for( ; *name != '\0' && len < PROFSY_FOLDED_PATH_MAX - 1; ++name )
+		stack->path[len++] = *name == ';' ? ':' : *name;
+	stack->path[len] = '\0';
+
+	stack->length[stack->depth]     = len;
+	stack->time[stack->depth]       = time;
+	stack->child_time[stack->depth] = 0;
+	++stack->depth;
+	return true;
+}
+
+// pop the top of stack and write it with its self-time, the time of the scope is added as child-time to its parent.
+static void profsy_folded_pop( profsy_writer* s, profsy_folded_stack* stack, uint64_t time )
+{
+	unsigned int top = stack->depth - 1;
+	uint64_t child_time = stack->child_time[top];
+	if( time > child_time )
+		profsy_writer_printf( s, "%s %llu\n", stack->path, (unsigned long long)( time - child_time ) );
+
+	stack->depth = top;
+	if( top > 0 )
+	{
+		stack->path[stack->length[top - 1]] = '\0';
+		stack->child_time[top - 1] += time;
+	}
+}
+
+static void profsy_util_dump_text( profsy_writer* s, profsy_trace_entry* entries )
+{
+	profsy_folded_stack stack;
+
+	// ... one pass per thread so that only one stack need to be kept, stacks are based at the thread-name ...
+	for( int thread = profsy_trace_next_thread( entries, -1 ); thread >= 0; thread = profsy_trace_next_thread( entries, thread ) )
+	{
+		stack.depth    = 0;
+		stack.overflow = 0;
+		bool root_open = false;
+
+		for( const profsy_trace_entry* e = entries; !profsy_trace_entry_is_end( e ); ++e )
+		{
+			if( (int)e->thread != thread || ( e->event != PROFSY_TRACE_EVENT_ENTER && e->event != PROFSY_TRACE_EVENT_LEAVE ) )
+				continue;
+
+			if( stack.depth == 0 )
+				profsy_folded_push( &stack, profsy_chrome_thread_name( e ), 0 );
+
+			const profsy_scope_data* data = profsy_get_scope_data( (int)e->scope );
+			if( e->event == PROFSY_TRACE_EVENT_ENTER )
+			{
+				// ... the thread-root, i.e. the frame, is the base of the stack ...
+				if( data->depth == 0 )
+				{
+					stack.time[0]       = e->ts;
+					stack.child_time[0] = 0;
+					root_open = true;
+				}
+				else
+					profsy_folded_push( &stack, data->name, e->ts );
+			}
+			else if( data->depth == 0 )
+			{
+				if( root_open && stack.depth == 1 )
+				{
+					uint64_t child_time = stack.child_time[0];
+					if( e->ts - stack.time[0] > child_time )
+						profsy_writer_printf( s, "%s %llu\n", stack.path, (unsigned long long)( e->ts - stack.time[0] - child_time ) );
+				}
+				root_open = false;
+			}
+			else if( stack.overflow > 0 )
+				--stack.overflow;
+			else if( stack.depth > 1 ) // ... scopes entered before the trace started has no stack ...
+				profsy_folded_pop( s, &stack, e->ts - stack.time[stack.depth - 1] );
+		}
+	}
+}
+
+void profsy_util_dump_tree( unsigned int mode,
+							void ( *callback )( const uint8_t* data, size_t byte_count, void* userdata ),
+							void* userdata )
+{
+	unsigned int num_scopes = 0;
+	const profsy_scope_data* const* scopes = profsy_scope_hierarchy( &num_scopes );
+	if( scopes == 0x0 )
+		return;
+
+	profsy_writer writer;
+	profsy_writer* s = &writer;
+	profsy_writer_init( s, mode, callback, userdata );
+
+	// ... the hierarchy is depth-first so a scope is finished, with all its child-time known, when a scope at the
+	// same or lower depth is reached ...
+	profsy_folded_stack stack;
+	stack.depth    = 0;
+	stack.overflow = 0;
+	for( unsigned int i = 0; i <= num_scopes; ++i )
+	{
+		unsigned int depth = i < num_scopes ? scopes[i]->depth : 0;
+		while( stack.depth > depth )
+			profsy_folded_pop( s, &stack, stack.time[stack.depth - 1] );
+
+		if( i < num_scopes && depth == stack.depth )
+			profsy_folded_push( &stack, scopes[i]->name, scopes[i]->time );
+	}
+	profsy_writer_flush( s );
+}
+
+void profsy_util_dump_tree_to_stream( FILE* f )
 {
+	profsy_util_dump_tree( PROFSY_UTIL_DUMP_MODE_CHUNK, profsy_writer_stream_callback, f );
+}
+
+static const char PROFSY_SPEEDSCOPE_HEADER[] =
+	PROFSY_STRINGIFY( { "$schema":"https://www.speedscope.app/file-format-schema.json",
+						"exporter":"profsy",
+						"activeProfileIndex":0,
+						"shared":{ "frames":[ );
+
+static const char PROFSY_SPEEDSCOPE_PROFILE[] =
+	PROFSY_STRINGIFY( { "type":"evented",
+						"name":"%s",
+						"unit":"nanoseconds",
+						"startValue":%llu,
+						"endValue":%llu,
+						"events":[ );
+
+static const char PROFSY_SPEEDSCOPE_EVENT[] =
+	PROFSY_STRINGIFY( { "type":"%c", "frame":%u, "at":%llu } );
+
+// true if e is the enter or leave of a scope that is not a thread-root, roots are frame-markers and are not properly
+// nested with scopes that are open over a frame-swap.
+static bool profsy_trace_entry_is_scope( const profsy_trace_entry* e )
+{
+	if( e->event != PROFSY_TRACE_EVENT_ENTER && e->event != PROFSY_TRACE_EVENT_LEAVE )
+		return false;
+	const profsy_scope_data* data = profsy_get_scope_data( (int)e->scope );
+	return data != 0x0 && data->depth > 0;
+}
+
+// max number of distinct scopes in a speedscope-dump, scopes after that are dropped from the dump with their child-scopes.
+static const unsigned int PROFSY_SPEEDSCOPE_FRAMES_MAX = 4096;
+
+// table of the scopes used in a trace, overflowed scopes get ids after all entries so frames can not be indexed by scope-id.
+struct profsy_speedscope_frames
+{
+	uint32_t     scope[PROFSY_SPEEDSCOPE_FRAMES_MAX];      // scope-id of each frame, in order of first use.
+	uint16_t     lookup[PROFSY_SPEEDSCOPE_FRAMES_MAX * 2]; // open-addressed hash-table from scope-id to frame-index + 1, 0 if empty.
+	unsigned int used;
+};
+
+// return the frame-index of scope_id, adding it to frames if insert is set, or -1 if it is not found or frames is full.
+static int profsy_speedscope_frame( profsy_speedscope_frames* frames, uint32_t scope_id, bool insert )
+{
+	unsigned int slot = ( scope_id * 2654435761u ) % ( PROFSY_SPEEDSCOPE_FRAMES_MAX * 2 );
+	while( frames->lookup[slot] != 0 )
+	{
+		unsigned int index = frames->lookup[slot] - 1u;
+		if( frames->scope[index] == scope_id )
+			return (int)index;
+		slot = ( slot + 1 ) % ( PROFSY_SPEEDSCOPE_FRAMES_MAX * 2 );
+	}
+
+	if( !insert || frames->used >= PROFSY_SPEEDSCOPE_FRAMES_MAX )
+		return -1;
+	frames->scope[frames->used] = scope_id;
+	frames->lookup[slot] = (uint16_t)++frames->used;
+	return (int)frames->used - 1;
+}
+
+static void profsy_util_dump_speedscope( profsy_writer* s, profsy_trace_entry* entries )
+{
+	// ... only the scopes used in the trace is written as frames ...
+	profsy_speedscope_frames frames;
+	frames.used = 0;
+	memset( frames.lookup, 0x0, sizeof( frames.lookup ) );
+	for( const profsy_trace_entry* e = entries; !profsy_trace_entry_is_end( e ); ++e )
+		if( profsy_trace_entry_is_scope( e ) )
+			profsy_speedscope_frame( &frames, e->scope, true );
+
+	profsy_writer_printf( s, "%s", PROFSY_SPEEDSCOPE_HEADER );
+	for( unsigned int i = 0; i < frames.used; ++i )
+	{
+		const profsy_scope_data* data = profsy_get_scope_data( (int)frames.scope[i] );
+		profsy_writer_printf( s, "%s{\"name\":", i == 0 ? "" : ",\n" );
+		profsy_chrome_write_string( s, data != 0x0 && data->name != 0x0 ? data->name : "" );
+		if( data != 0x0 && data->desc != 0x0 )
+		{
+			profsy_writer_printf( s, ", \"file\":" );
+			profsy_chrome_write_string( s, data->desc->file );
+			profsy_writer_printf( s, ", \"line\":%u", (unsigned int)data->desc->line );
+		}
+		profsy_writer_putc( s, '}' );
+	}
+	profsy_writer_printf( s, "] },\n\"profiles\":[\n" );
+
+	// ... one profile per thread, scopes left open at the end of the trace is closed at the last event ...
+	const char* profile_separator = "";
+	for( int thread = profsy_trace_next_thread( entries, -1 ); thread >= 0; thread = profsy_trace_next_thread( entries, thread ) )
+	{
+		uint64_t start = 0;
+		uint64_t end   = 0;
+		const profsy_trace_entry* first = 0x0;
+		for( const profsy_trace_entry* e = entries; !profsy_trace_entry_is_end( e ); ++e )
+		{
+			if( (int)e->thread != thread || !profsy_trace_entry_is_scope( e ) )
+				continue;
+			if( first == 0x0 )
+			{
+				first = e;
+				start = e->ts;
+			}
+			end = e->ts;
+		}
+		if( first == 0x0 )
+			continue;
+
+		profsy_writer_printf( s, "%s", profile_separator );
+		profsy_writer_printf( s, PROFSY_SPEEDSCOPE_PROFILE, profsy_chrome_thread_name( first ), (unsigned long long)start, (unsigned long long)end );
+
+		uint32_t     stack[PROFSY_FOLDED_DEPTH_MAX];
+		unsigned int depth    = 0;
+		unsigned int overflow = 0;
+		const char*  separator = "\n";
+		for( const profsy_trace_entry* e = entries; !profsy_trace_entry_is_end( e ); ++e )
+		{
+			if( (int)e->thread != thread || !profsy_trace_entry_is_scope( e ) )
+				continue;
+
+			int frame = profsy_speedscope_frame( &frames, e->scope, false );
+			if( e->event == PROFSY_TRACE_EVENT_ENTER )
+			{
+				// ... scopes to deep or without frame is dropped with all their child-scopes ...
+				if( depth == PROFSY_FOLDED_DEPTH_MAX || overflow > 0 || frame < 0 )
+				{
+					++overflow;
+					continue;
+				}
+				stack[depth++] = (uint32_t)frame;
+			}
+			else if( overflow > 0 )
+			{
+				--overflow;
+				continue;
+			}
+			else if( depth == 0 )
+				continue; // ... scopes entered before the trace started can not be closed ...
+			else
+				--depth;
+
+			profsy_writer_printf( s, "%s", separator );
+			profsy_writer_printf( s, PROFSY_SPEEDSCOPE_EVENT, e->event == PROFSY_TRACE_EVENT_ENTER ? 'O' : 'C', (unsigned int)frame, (unsigned long long)e->ts );
+			separator = ",\n";
+		}
+		while( depth > 0 )
+		{
+			profsy_writer_printf( s, "%s", separator );
+			profsy_writer_printf( s, PROFSY_SPEEDSCOPE_EVENT, 'C', (unsigned int)stack[--depth], (unsigned long long)end );
+			separator = ",\n";
+		}
+
+		profsy_writer_printf( s, "\n] }" );
+		profile_separator = ",\n";
+	}
+
+	profsy_writer_printf( s, "\n] }\n" );
+}
+
+// max size of one encoded trace-packet in the perfetto-format, packets that do not fit is dropped.
+static const size_t PROFSY_PB_PACKET_MAX = 1024;
+
+// max length of strings in perfetto-packets, longer strings is clipped.
+static const size_t PROFSY_PB_STRING_MAX = 256;
+
+// field-numbers in perfetto_trace.proto
+static const uint32_t PROFSY_PB_TRACE_PACKET                   = 1;
+static const uint32_t PROFSY_PB_PACKET_TIMESTAMP               = 8;
+static const uint32_t PROFSY_PB_PACKET_SEQUENCE_ID             = 10;
+static const uint32_t PROFSY_PB_PACKET_TRACK_EVENT             = 11;
+static const uint32_t PROFSY_PB_PACKET_TRACK_DESCRIPTOR        = 60;
+static const uint32_t PROFSY_PB_TRACK_EVENT_DEBUG_ANNOTATIONS  = 4;
+static const uint32_t PROFSY_PB_TRACK_EVENT_TYPE               = 9;
+static const uint32_t PROFSY_PB_TRACK_EVENT_TRACK_UUID         = 11;
+static const uint32_t PROFSY_PB_TRACK_EVENT_NAME               = 23;
+static const uint32_t PROFSY_PB_TRACK_EVENT_COUNTER_VALUE      = 30;
+static const uint32_t PROFSY_PB_TRACK_EVENT_FLOW_IDS           = 47;
+static const uint32_t PROFSY_PB_TRACK_EVENT_TERMINATING_FLOWS  = 48;
+static const uint32_t PROFSY_PB_DEBUG_ANNOTATION_INT_VALUE     = 4;
+static const uint32_t PROFSY_PB_DEBUG_ANNOTATION_NAME          = 10;
+static const uint32_t PROFSY_PB_TRACK_DESCRIPTOR_UUID          = 1;
+static const uint32_t PROFSY_PB_TRACK_DESCRIPTOR_NAME          = 2;
+static const uint32_t PROFSY_PB_TRACK_DESCRIPTOR_THREAD        = 4;
+static const uint32_t PROFSY_PB_TRACK_DESCRIPTOR_PARENT_UUID   = 5;
+static const uint32_t PROFSY_PB_TRACK_DESCRIPTOR_COUNTER       = 8;
+static const uint32_t PROFSY_PB_THREAD_DESCRIPTOR_PID          = 1;
+static const uint32_t PROFSY_PB_THREAD_DESCRIPTOR_TID          = 2;
+static const uint32_t PROFSY_PB_THREAD_DESCRIPTOR_THREAD_NAME  = 5;
+
+static const uint64_t PROFSY_PB_TYPE_SLICE_BEGIN = 1;
+static const uint64_t PROFSY_PB_TYPE_SLICE_END   = 2;
+static const uint64_t PROFSY_PB_TYPE_INSTANT     = 3;
+static const uint64_t PROFSY_PB_TYPE_COUNTER     = 4;
+
+static const uint32_t PROFSY_PB_WIRE_VARINT  = 0;
+static const uint32_t PROFSY_PB_WIRE_FIXED64 = 1;
+static const uint32_t PROFSY_PB_WIRE_BYTES   = 2;
+
+// track-uuids for the different kinds of tracks, the low bits is thread-id, counter-id or span-handle.
+static const uint64_t PROFSY_PB_TRACK_THREAD  = 1ULL << 60;
+static const uint64_t PROFSY_PB_TRACK_COUNTER = 2ULL << 60;
+static const uint64_t PROFSY_PB_TRACK_SPAN    = 3ULL << 60;
+
+// one trace-packet being encoded, nested messages is written with a 4 byte length that is patched when the message
+// is ended, as protozero does, so that no message need to be encoded twice.
+struct profsy_pb_packet
+{
+	uint8_t data[PROFSY_PB_PACKET_MAX];
+	size_t  used;
+	bool    full; // true if anything did not fit in data.
+};
+
+static void profsy_pb_bytes( profsy_pb_packet* p, const void* data, size_t size )
+{
+	if( p->full || p->used + size > sizeof( p->data ) )
+	{
+		p->full = true;
+		return;
+	}
+	memcpy( p->data + p->used, data, size );
+	p->used += size;
+}
+
+static void profsy_pb_varint( profsy_pb_packet* p, uint64_t value )
+{
+	uint8_t bytes[10];
+	size_t  size = 0;
+	do
+	{
+		bytes[size] = (uint8_t)( ( value & 0x7F ) | ( value > 0x7F ? 0x80 : 0 ) );
+		value >>= 7;
+		++size;
+	} while( value != 0 );
+	profsy_pb_bytes( p, bytes, size );
+}
+
+static void profsy_pb_tag( profsy_pb_packet* p, uint32_t field, uint32_t wire_type )
+{
+	profsy_pb_varint( p, ( field << 3 ) | wire_type );
+}
+
+static void profsy_pb_uint( profsy_pb_packet* p, uint32_t field, uint64_t value )
+{
+	profsy_pb_tag( p, field, PROFSY_PB_WIRE_VARINT );
+	profsy_pb_varint( p, value );
+}
+
+static void profsy_pb_fixed64( profsy_pb_packet* p, uint32_t field, uint64_t value )
+{
+	uint8_t bytes[8];
+	for( size_t i = 0; i < sizeof( bytes ); ++i )
+		bytes[i] = (uint8_t)( value >> ( i * 8 ) );
+	profsy_pb_tag( p, field, PROFSY_PB_WIRE_FIXED64 );
+	profsy_pb_bytes( p, bytes, sizeof( bytes ) );
+}
+
+static void profsy_pb_string( profsy_pb_packet* p, uint32_t field, const char* str )
+{
+	size_t len = str == 0x0 ? 0 : strlen( str );
+	if( len > PROFSY_PB_STRING_MAX )
+		len = PROFSY_PB_STRING_MAX;
+	profsy_pb_tag( p, field, PROFSY_PB_WIRE_BYTES );
+	profsy_pb_varint( p, len );
+	profsy_pb_bytes( p, str, len );
+}
+
+// start nested message in field, returns mark to pass to profsy_pb_end().
+static size_t profsy_pb_begin( profsy_pb_packet* p, uint32_t field )
+{
+	static const uint8_t LENGTH_PLACEHOLDER[4] = { 0, 0, 0, 0 };
+	profsy_pb_tag( p, field, PROFSY_PB_WIRE_BYTES );
+	size_t mark = p->used;
+	profsy_pb_bytes( p, LENGTH_PLACEHOLDER, sizeof( LENGTH_PLACEHOLDER ) );
+	return mark;
+}
+
+static void profsy_pb_end( profsy_pb_packet* p, size_t mark )
+{
+	if( p->full )
+		return;
+
+	// ... length is written as a 4 byte varint with redundant continuation-bits, valid for messages up to 256MB ...
+	size_t len = p->used - mark - 4;
+	p->data[mark + 0] = (uint8_t)( ( len         & 0x7F ) | 0x80 );
+	p->data[mark + 1] = (uint8_t)( ( ( len >> 7 )  & 0x7F ) | 0x80 );
+	p->data[mark + 2] = (uint8_t)( ( ( len >> 14 ) & 0x7F ) | 0x80 );
+	p->data[mark + 3] = (uint8_t)(   ( len >> 21 ) & 0x7F );
+}
+
+// start a TracePacket, all packets is written on one sequence.
+static size_t profsy_pb_packet_begin( profsy_pb_packet* p )
+{
+	p->used = 0;
+	p->full = false;
+	size_t mark = profsy_pb_begin( p, PROFSY_PB_TRACE_PACKET );
+	profsy_pb_uint( p, PROFSY_PB_PACKET_SEQUENCE_ID, 1 );
+	return mark;
+}
+
+static void profsy_pb_packet_end( profsy_writer* s, profsy_pb_packet* p, size_t mark )
+{
+	profsy_pb_end( p, mark );
+	if( p->full )
+		return;
+	profsy_writer_write( s, p->data, p->used );
+	profsy_writer_end_record( s );
+}
+
+static void profsy_pb_write_track( profsy_writer* s, profsy_pb_packet* p, uint64_t uuid, uint64_t parent_uuid, const char* name, uint32_t kind_field )
+{
+	size_t packet = profsy_pb_packet_begin( p );
+	size_t track  = profsy_pb_begin( p, PROFSY_PB_PACKET_TRACK_DESCRIPTOR );
+	profsy_pb_uint( p, PROFSY_PB_TRACK_DESCRIPTOR_UUID, uuid );
+	if( parent_uuid != 0 )
+		profsy_pb_uint( p, PROFSY_PB_TRACK_DESCRIPTOR_PARENT_UUID, parent_uuid );
+	profsy_pb_string( p, PROFSY_PB_TRACK_DESCRIPTOR_NAME, name );
+	if( kind_field == PROFSY_PB_TRACK_DESCRIPTOR_THREAD )
+	{
+		size_t thread = profsy_pb_begin( p, PROFSY_PB_TRACK_DESCRIPTOR_THREAD );
+		profsy_pb_uint( p, PROFSY_PB_THREAD_DESCRIPTOR_PID, (uint64_t)(uint32_t)profsy_getpid() );
+		profsy_pb_uint( p, PROFSY_PB_THREAD_DESCRIPTOR_TID, ( uuid & 0xFFFF ) + 1 );
+		profsy_pb_string( p, PROFSY_PB_THREAD_DESCRIPTOR_THREAD_NAME, name );
+		profsy_pb_end( p, thread );
+	}
+	else if( kind_field == PROFSY_PB_TRACK_DESCRIPTOR_COUNTER )
+		profsy_pb_end( p, profsy_pb_begin( p, PROFSY_PB_TRACK_DESCRIPTOR_COUNTER ) );
+	profsy_pb_end( p, track );
+	profsy_pb_packet_end( s, p, packet );
+}
+
+// add all arguments to event e, except name, as debug-annotations.
+static void profsy_pb_write_args( profsy_pb_packet* p, const profsy_trace_entry* e )
+{
+	for( const profsy_trace_entry* arg = profsy_trace_entry_next_arg( e, e ); arg != 0x0; arg = profsy_trace_entry_next_arg( e, arg ) )
+	{
+		char        arg_name[16];
+		const char* name = arg_name;
+		switch( arg->scope )
+		{
+			case PROFSY_TRACE_ARG_NAME:             continue;
+			case PROFSY_TRACE_ARG_CPU:              name = "cpu"; break;
+			case PROFSY_TRACE_ARG_CONTEXT_SWITCHES: name = "context_switches"; break;
+			default: snprintf( arg_name, sizeof( arg_name ), "arg%u", (unsigned int)arg->scope ); break;
+		}
+		size_t annotation = profsy_pb_begin( p, PROFSY_PB_TRACK_EVENT_DEBUG_ANNOTATIONS );
+		profsy_pb_string( p, PROFSY_PB_DEBUG_ANNOTATION_NAME, name );
+		profsy_pb_uint( p, PROFSY_PB_DEBUG_ANNOTATION_INT_VALUE, arg->arg );
+		profsy_pb_end( p, annotation );
+	}
+}
+
+static void profsy_util_dump_perfetto( profsy_writer* s, profsy_trace_entry* entries )
+{
+	profsy_pb_packet p;
+
+	// ... tracks need to be described before they are used ...
+	for( int thread = profsy_trace_next_thread( entries, -1 ); thread >= 0; thread = profsy_trace_next_thread( entries, thread ) )
+	{
+		const char* name = profsy_thread_name( thread );
+		profsy_pb_write_track( s, &p, PROFSY_PB_TRACK_THREAD | (uint64_t)thread, 0, name ? name : "", PROFSY_PB_TRACK_DESCRIPTOR_THREAD );
+	}
+
+	bool counter_described[PROFSY_COUNTERS_MAX];
+	memset( counter_described, 0x0, sizeof( counter_described ) );
+
+	for( profsy_trace_entry* e = entries; !profsy_trace_entry_is_end( e ); ++e )
+	{
+		uint64_t    thread_track = PROFSY_PB_TRACK_THREAD | e->thread;
+		uint64_t    track = thread_track;
+		uint64_t    type;
+		const char* name  = 0x0;
+		switch( e->event )
+		{
+			case PROFSY_TRACE_EVENT_ENTER:
+			case PROFSY_TRACE_EVENT_LEAVE:
+				if( !profsy_trace_entry_is_scope( e ) )
+					continue;
+				type = e->event == PROFSY_TRACE_EVENT_ENTER ? PROFSY_PB_TYPE_SLICE_BEGIN : PROFSY_PB_TYPE_SLICE_END;
+				if( e->event == PROFSY_TRACE_EVENT_ENTER )
+					name = profsy_get_scope_data( (int)e->scope )->name;
+				break;
+			case PROFSY_TRACE_EVENT_INSTANT:
+			case PROFSY_TRACE_EVENT_FLOW_BEGIN:
+			case PROFSY_TRACE_EVENT_FLOW_STEP:
+			case PROFSY_TRACE_EVENT_FLOW_END:
+				type = PROFSY_PB_TYPE_INSTANT;
+				name = (const char*)(uintptr_t)profsy_trace_entry_arg( e, PROFSY_TRACE_ARG_NAME );
+				break;
+			case PROFSY_TRACE_EVENT_SPAN_BEGIN:
+			case PROFSY_TRACE_EVENT_SPAN_END:
+				// ... each span is a track of its own as spans can overlap ...
+				track = PROFSY_PB_TRACK_SPAN | profsy_trace_entry_arg( e, 0 );
+				type  = e->event == PROFSY_TRACE_EVENT_SPAN_BEGIN ? PROFSY_PB_TYPE_SLICE_BEGIN : PROFSY_PB_TYPE_SLICE_END;
+				name  = (const char*)(uintptr_t)profsy_trace_entry_arg( e, PROFSY_TRACE_ARG_NAME );
+				if( e->event == PROFSY_TRACE_EVENT_SPAN_BEGIN )
+					profsy_pb_write_track( s, &p, track, thread_track, name, 0 );
+				break;
+			case PROFSY_TRACE_EVENT_COUNTER:
+				track = PROFSY_PB_TRACK_COUNTER | e->scope;
+				type  = PROFSY_PB_TYPE_COUNTER;
+				if( e->scope < PROFSY_COUNTERS_MAX && !counter_described[e->scope] )
+				{
+					profsy_pb_write_track( s, &p, track, 0, profsy_get_counter_data( (int)e->scope )->name, PROFSY_PB_TRACK_DESCRIPTOR_COUNTER );
+					counter_described[e->scope] = true;
+				}
+				break;
+			default:
+				continue; // ... arguments are written together with the event they belong to ...
+		}
+
+		size_t packet = profsy_pb_packet_begin( &p );
+		profsy_pb_uint( &p, PROFSY_PB_PACKET_TIMESTAMP, e->ts );
+		size_t event = profsy_pb_begin( &p, PROFSY_PB_PACKET_TRACK_EVENT );
+		profsy_pb_uint( &p, PROFSY_PB_TRACK_EVENT_TYPE, type );
+		profsy_pb_uint( &p, PROFSY_PB_TRACK_EVENT_TRACK_UUID, track );
+		if( name != 0x0 && type != PROFSY_PB_TYPE_SLICE_END )
+			profsy_pb_string( &p, PROFSY_PB_TRACK_EVENT_NAME, name );
+
+		switch( e->event )
+		{
+			case PROFSY_TRACE_EVENT_COUNTER:
+				profsy_pb_uint( &p, PROFSY_PB_TRACK_EVENT_COUNTER_VALUE, profsy_trace_entry_arg( e, 0 ) );
+				break;
+			case PROFSY_TRACE_EVENT_FLOW_BEGIN:
+			case PROFSY_TRACE_EVENT_FLOW_STEP:
+				profsy_pb_fixed64( &p, PROFSY_PB_TRACK_EVENT_FLOW_IDS, profsy_trace_entry_arg( e, 0 ) );
+				break;
+			case PROFSY_TRACE_EVENT_FLOW_END:
+				profsy_pb_fixed64( &p, PROFSY_PB_TRACK_EVENT_TERMINATING_FLOWS, profsy_trace_entry_arg( e, 0 ) );
+				break;
+			case PROFSY_TRACE_EVENT_ENTER:
+			case PROFSY_TRACE_EVENT_LEAVE:
+			case PROFSY_TRACE_EVENT_INSTANT:
+				profsy_pb_write_args( &p, e );
+				break;
+		}
+
+		profsy_pb_end( &p, event );
+		profsy_pb_packet_end( s, &p, packet );
+	}
+}
+
+void profsy_util_dump( profsy_trace_entry* entries,
+					   unsigned int format,
+					   unsigned int mode,
+					   void ( *callback )( const uint8_t* data, size_t byte_count, void* userdata ),
+					   void* userdata )
+{
+	profsy_writer writer;
+	profsy_writer_init( &writer, mode, callback, userdata );
+
 	switch( format )
 	{
-		case PROFSY_UTIL_DUMP_FORMAT_TEXT:   profsy_util_dump_text( s, entries ); break;
-		case PROFSY_UTIL_DUMP_FORMAT_CHROME: profsy_util_dump_chrome( s, entries ); break;
+		case PROFSY_UTIL_DUMP_FORMAT_TEXT:       profsy_util_dump_text( &writer, entries ); break;
+		case PROFSY_UTIL_DUMP_FORMAT_CHROME:     profsy_util_dump_chrome( &writer, entries ); break;
+		case PROFSY_UTIL_DUMP_FORMAT_SPEEDSCOPE: profsy_util_dump_speedscope( &writer, entries ); break;
+		case PROFSY_UTIL_DUMP_FORMAT_PERFETTO:   profsy_util_dump_perfetto( &writer, entries ); break;
 	}
+	profsy_writer_flush( &writer );
+}
+
+void profsy_util_dump_to_stream( FILE* s, profsy_trace_entry* entries, unsigned int format )
+{
+	profsy_util_dump( entries, format, PROFSY_UTIL_DUMP_MODE_CHUNK, profsy_writer_stream_callback, s );
 }
 
 void profsy_util_dump_to_file( const char* filename, profsy_trace_entry* entries, unsigned int format )
 {
-	FILE* f = fopen( filename, "wt" );
+	FILE* f = fopen( filename, format == PROFSY_UTIL_DUMP_FORMAT_PERFETTO ? "wb" : "wt" );
 	if( f == 0x0 )
 		return;
 	profsy_util_dump_to_stream( f, entries, format );
@@ -26,8 +26,11 @@
 
 #include "greatest.h"
 #include <profsy/profsy.h>
+#include <profsy/profsy_util.h>
 
 #include <malloc.h>
+#include <string.h>
+#include <time.h>
 
 #define ARRAY_LENGTH(a) (sizeof(a)/sizeof(a[0]))
 
@@ -36,9 +39,31 @@
 	#define SLEEP( ms ) SleepEx( ms, false )
 #else
 	#include <unistd.h>
+	#include <pthread.h>
 	#define SLEEP( ms ) usleep( ms )
 #endif
 
+// run func( arg ) on a new os-thread.
+struct test_thread_func
+{
+	void (*func)( int );
+	int arg;
+};
+
+#if defined( _MSC_VER )
+	typedef HANDLE test_thread;
+	static DWORD WINAPI test_thread_main( LPVOID f ) { ( (test_thread_func*)f )->func( ( (test_thread_func*)f )->arg ); return 0; }
+	static test_thread test_thread_start( test_thread_func* f ) { return CreateThread( 0x0, 0, test_thread_main, f, 0, 0x0 ); }
+	static void test_thread_join( test_thread t ) { WaitForSingleObject( t, INFINITE ); CloseHandle( t ); }
+	static void test_atomic_inc( volatile long* v ) { _InterlockedIncrement( v ); }
+#else
+	typedef pthread_t test_thread;
+	static void* test_thread_main( void* f ) { ( (test_thread_func*)f )->func( ( (test_thread_func*)f )->arg ); return 0x0; }
+	static test_thread test_thread_start( test_thread_func* f ) { pthread_t t; pthread_create( &t, 0x0, test_thread_main, f ); return t; }
+	static void test_thread_join( test_thread t ) { pthread_join( t, 0x0 ); }
+	static void test_atomic_inc( volatile long* v ) { __sync_fetch_and_add( v, 1 ); }
+#endif
+
 TEST profsy_setup_teardown()
 {
 	profsy_init_params ip;
@@ -274,198 +299,1782 @@ TEST profsy_two_paths()
 	return 0;
 }
 
-TEST profsy_find_scope_non_exist()
+static void dynamic_scope_func( const char* name )
 {
-	profsy_setup s( 256 );
-	ASSERT( s.mem != 0x0 );
-	ASSERT_EQ( -1, profsy_find_scope( "bloo.blaaa" ) ); // non existing scope!
-	return 0;
+	PROFSY_SCOPE_DYNAMIC( name, PROFSY_CATEGORY_DEFAULT );
 }
 
-TEST profsy_out_of_resources_is_tracked()
+TEST profsy_dynamic_scope_names()
 {
-	profsy_setup st( 4 );
+	profsy_setup st( 16 );
 	ASSERT( st.mem != 0x0 );
+
+	// ... names built at runtime are found by name on every call instead of by the call-site ...
+	static char names[2][16];
+	for( unsigned int i = 0; i < 4; ++i )
 	{
-		PROFSY_SCOPE("s1");
-		PROFSY_SCOPE("s2");
-		PROFSY_SCOPE("s3");
-		PROFSY_SCOPE("s4");
-		PROFSY_SCOPE("s5"); // this scope will overflow...
-		PROFSY_SCOPE("s6"); // this scope will overflow...
+		char* name = names[i % 2];
+		snprintf( name, sizeof( names[0] ), "asset%u", i % 2 );
+		dynamic_scope_func( name );
 	}
-
 	profsy_swap_frame();
-	ASSERT_EQ( 6u, profsy_num_active_scopes() ); // max amount of scopes active...
 
+	const profsy_scope_data* asset0 = profsy_get_scope_data( profsy_find_scope( "asset0" ) );
+	const profsy_scope_data* asset1 = profsy_get_scope_data( profsy_find_scope( "asset1" ) );
+	ASSERT( asset0 != 0x0 );
+	ASSERT( asset1 != 0x0 );
+	ASSERT_EQ( 2u, asset0->calls );
+	ASSERT_EQ( 2u, asset1->calls );
+	ASSERT_EQ( (const profsy_scope_desc*)0x0, asset0->desc );
+	return 0;
+}
+
+TEST profsy_hierarchy_is_kept_in_order()
+{
+	profsy_setup st( 256 );
+	ASSERT( st.mem != 0x0 );
+
+	int render = profsy_create_thread_ctx( "render" );
+
+	{ PROFSY_SCOPE( "parent_scope1" ); scoped_func1(); }
+	{ PROFSY_SCOPE( "parent_scope2" ); scoped_func1(); }
+	profsy_scope_leave_thread( render, profsy_scope_enter_thread( render, "render_scope", 0 ), 0, 1 );
+	{ PROFSY_SCOPE( "parent_scope1" ); scoped_func2(); } // new scope in the middle of the hierarchy.
+
+	unsigned int num_scopes;
+	const profsy_scope_data* const* view = profsy_scope_hierarchy( &num_scopes );
+	ASSERT_EQ( 10u, num_scopes );
+
+	static const char* EXPECT[] = {
+		"main", "parent_scope1", "scoped_func1", "scoped_func2", "parent_scope2", "scoped_func1", "overflow scope",
+		"render", "render_scope", "overflow scope"
+	};
+	for( unsigned int i = 0; i < ARRAY_LENGTH( EXPECT ); ++i )
+		ASSERT_STR_EQ( EXPECT[i], view[i]->name );
+
+	// copy is bounded by the size of the array.
 	const profsy_scope_data* hierarchy[16];
-	profsy_get_scope_hierarchy( hierarchy, 16 );
+	hierarchy[3] = 0x0;
+	ASSERT_EQ( 3u, profsy_get_scope_hierarchy( hierarchy, 3 ) );
+	ASSERT_EQ( (const profsy_scope_data*)0x0, hierarchy[3] );
+	ASSERT_EQ( 10u, profsy_get_scope_hierarchy( hierarchy, 16 ) );
+	for( unsigned int i = 0; i < num_scopes; ++i )
+		ASSERT_EQ( view[i], hierarchy[i] );
+	return 0;
+}
 
-	const profsy_scope_data* s;
-	s = hierarchy[0];
-	ASSERT_STR_EQ( s->name,  "main" );
-	ASSERT_EQ    ( s->calls, 1u );
+static void recursive_func( int depth )
+{
+	PROFSY_SCOPE( "recursive_func" );
+	SLEEP(1);
+	if( depth > 0 )
+		recursive_func( depth - 1 );
+}
 
-	s = hierarchy[1]; ASSERT_STR_EQ( s->name,  "s1" ); ASSERT_EQ( s->calls, 1u );
-	s = hierarchy[2]; ASSERT_STR_EQ( s->name,  "s2" ); ASSERT_EQ( s->calls, 1u );
-	s = hierarchy[3]; ASSERT_STR_EQ( s->name,  "s3" ); ASSERT_EQ( s->calls, 1u );
-	s = hierarchy[4]; ASSERT_STR_EQ( s->name,  "s4" ); ASSERT_EQ( s->calls, 1u );
+TEST profsy_name_data_aggregates_paths()
+{
+	profsy_setup st( 256 );
+	ASSERT( st.mem != 0x0 );
 
-	s = hierarchy[5];
-	ASSERT_STR_EQ( s->name,  "overflow scope" );
-	ASSERT_EQ    ( s->calls, 2u ); // 2 calls, "s3" and "s4"
+	{ PROFSY_SCOPE( "parent_scope1" ); scoped_func1(); scoped_func1(); }
+	{ PROFSY_SCOPE( "parent_scope2" ); scoped_func1(); recursive_func( 2 ); }
+
+	profsy_swap_frame();
+
+	const profsy_name_data* names[16];
+	ASSERT_EQ( 4u, profsy_get_name_data( names, 16 ) );
+
+	ASSERT_STR_EQ( "parent_scope1", names[0]->name );
+	ASSERT_STR_EQ( "scoped_func1",  names[1]->name );
+	ASSERT_STR_EQ( "parent_scope2", names[2]->name );
+	ASSERT_STR_EQ( "recursive_func", names[3]->name );
+
+	const profsy_scope_data* f1_1 = profsy_get_scope_data( profsy_find_scope( "parent_scope1.scoped_func1" ) );
+	const profsy_scope_data* f1_2 = profsy_get_scope_data( profsy_find_scope( "parent_scope2.scoped_func1" ) );
+	ASSERT_EQ( 3u, names[1]->calls );
+	ASSERT_EQ( f1_1->time + f1_2->time, names[1]->time );
+	ASSERT_EQ( names[1]->time, names[1]->self_time );
+
+	// recursive calls are only counted once in time, but all calls are reported.
+	const profsy_scope_data* r = profsy_get_scope_data( profsy_find_scope( "parent_scope2.recursive_func" ) );
+	ASSERT_EQ( 3u, names[3]->calls );
+	ASSERT_EQ( r->time, names[3]->time );
+	ASSERT( names[3]->self_time > 0u );
+	ASSERT( names[3]->self_time <= names[3]->time );
+
+	ASSERT_EQ( 1u, profsy_get_name_data( names, 1 ) );
 	return 0;
 }
 
-static void test_it( bool do_scope )
+TEST profsy_find_scope_non_exist()
 {
-	if( do_scope )
+	profsy_setup s( 256 );
+	ASSERT( s.mem != 0x0 );
+	ASSERT_EQ( -1, profsy_find_scope( "bloo.blaaa" ) ); // non existing scope!
+	return 0;
+}
+
+TEST profsy_find_scope_all_threads()
+{
+	profsy_setup s( 256 );
+	ASSERT( s.mem != 0x0 );
+
+	int render = profsy_create_thread_ctx( "render" );
+	ASSERT_EQ( 1, render );
+
+	// ... paths are hashed from the thread-name so it can only be used once ...
+	static char render_copy[] = "render";
+	ASSERT_EQ( -1, profsy_create_thread_ctx( render_copy ) );
+	ASSERT_EQ( -1, profsy_set_thread_group( render, "main" ) );
+
 	{
-		PROFSY_SCOPE( "s5" );
+		PROFSY_SCOPE( "a" );
+		PROFSY_SCOPE( "b" );
 	}
+
+	int ra = profsy_scope_enter_thread( render, "a", 0 );
+	int rb = profsy_scope_enter_thread( render, "b", 0 );
+	profsy_scope_leave_thread( render, rb, 0, 1 );
+	profsy_scope_leave_thread( render, ra, 0, 1 );
+
+	ASSERT_EQ( 0,  profsy_find_scope( "" ) );
+	ASSERT_EQ( 0,  profsy_find_scope( "main/" ) );
+	ASSERT_EQ( 2,  profsy_find_scope( "render/" ) );
+	ASSERT_EQ( profsy_find_scope( "a" ),   profsy_find_scope( "main/a" ) );
+	ASSERT_EQ( profsy_find_scope( "a.b" ), profsy_find_scope( "main/a.b" ) );
+	ASSERT_EQ( ra, profsy_find_scope( "render/a" ) );
+	ASSERT_EQ( rb, profsy_find_scope( "render/a.b" ) );
+	ASSERT( profsy_find_scope( "a.b" ) != rb );
+	ASSERT_EQ( -1, profsy_find_scope( "render/b" ) );
+	ASSERT_EQ( -1, profsy_find_scope( "physics/a" ) );
+
+	ASSERT_STR_EQ( "b", profsy_get_scope_data( profsy_find_scope( "render/a.b" ) )->name );
+	return 0;
 }
 
-TEST profsy_multi_overflow()
+static void worker_frame( int thread_ctx, uint64_t job_time )
 {
-	profsy_setup st( 4 );
-	ASSERT( st.mem != 0x0 );
+	profsy_set_thread_ctx( thread_ctx );
 	{
-		for( int i = 0; i < 2; ++i )
-		{
-			{ PROFSY_SCOPE("s1"); test_it( i > 0 ); }
-			{ PROFSY_SCOPE("s2"); test_it( i > 0 ); }
-			{ PROFSY_SCOPE("s3"); test_it( i > 0 ); }
-		}
+		PROFSY_SCOPE( "job" );
+		int id = profsy_scope_enter( "work", 0 );
+		profsy_scope_leave( id, 0, job_time );
 	}
+	profsy_set_thread_ctx( 0 );
+}
+
+TEST profsy_thread_group_merge()
+{
+	profsy_setup st( 256 );
+	ASSERT( st.mem != 0x0 );
+
+	int w1 = profsy_create_thread_ctx( "worker1" );
+	int w2 = profsy_create_thread_ctx( "worker2" );
+
+	// scopes registered before being added to group should be merged as well.
+	worker_frame( w1, 10 );
+
+	int group = profsy_set_thread_group( w1, "workers" );
+	ASSERT( group > w2 );
+	ASSERT_EQ( group, profsy_set_thread_group( w2, "workers" ) );
+	ASSERT_EQ( -1, profsy_set_thread_group( group, "workers" ) );
 
 	profsy_swap_frame();
-	ASSERT_EQ( 6u, profsy_num_active_scopes() ); // max amount of scopes active...
+
+	worker_frame( w1, 10 );
+	worker_frame( w2, 30 );
+	worker_frame( w2, 30 );
+
+	profsy_swap_frame();
+
+	// scopes on thread-ctx are not registered on main.
+	ASSERT_EQ( -1, profsy_find_scope( "job" ) );
+	ASSERT_STR_EQ( "workers", profsy_get_scope_data( profsy_find_scope( "workers/" ) )->name );
+
+	const profsy_scope_data* work = profsy_get_scope_data( profsy_find_scope( "workers/job.work" ) );
+	ASSERT( work != 0x0 );
+	ASSERT_EQ( 3u,  work->calls );
+	ASSERT_EQ( 70u, work->time );
+	ASSERT_EQ( 60u, work->max_time );
+	ASSERT_EQ( 2u,  work->depth );
+
+	const profsy_scope_data* job = profsy_get_scope_data( profsy_find_scope( "workers/job" ) );
+	ASSERT_EQ( 3u,  job->calls );
+	ASSERT_EQ( 70u, job->child_time );
+
+	// merged tree is not counted twice in name-data.
+	const profsy_name_data* names[16];
+	unsigned int num_names = profsy_get_name_data( names, 16 );
+	for( unsigned int i = 0; i < num_names; ++i )
+		if( strcmp( names[i]->name, "work" ) == 0 )
+			ASSERT_EQ( 3u, names[i]->calls );
 
 	const profsy_scope_data* hierarchy[16];
-	profsy_get_scope_hierarchy( hierarchy, 16 );
+	ASSERT_EQ( 4u, profsy_get_thread_hierarchy( group, hierarchy, 16 ) );
+	ASSERT_STR_EQ( "workers",        hierarchy[0]->name );
+	ASSERT_STR_EQ( "job",            hierarchy[1]->name );
+	ASSERT_STR_EQ( "work",           hierarchy[2]->name );
+	ASSERT_STR_EQ( "overflow scope", hierarchy[3]->name );
+	return 0;
+}
 
-	const profsy_scope_data* s;
-	s = hierarchy[0]; ASSERT_STR_EQ( s->name, "main" ); ASSERT_EQ( s->calls, 1u );
-	s = hierarchy[1]; ASSERT_STR_EQ( s->name,   "s1" ); ASSERT_EQ( s->calls, 2u );
-	s = hierarchy[2]; ASSERT_STR_EQ( s->name,   "s5" ); ASSERT_EQ( s->calls, 1u );
-	s = hierarchy[3]; ASSERT_STR_EQ( s->name,   "s2" ); ASSERT_EQ( s->calls, 2u );
-	s = hierarchy[5]; ASSERT_STR_EQ( s->name,   "s3" ); ASSERT_EQ( s->calls, 2u );
+static const unsigned int REGISTER_WORKER_SCOPES = 256;
+static char register_worker_names[REGISTER_WORKER_SCOPES][8];
+
+static void register_worker( int thread_ctx )
+{
+	profsy_set_thread_ctx( thread_ctx );
+	int job = profsy_scope_enter( "job", 0 );
+	for( unsigned int i = 0; i < REGISTER_WORKER_SCOPES; ++i )
+		profsy_scope_leave( profsy_scope_enter( register_worker_names[i], 0 ), 0, 1 );
+	profsy_scope_leave( job, 0, 1 );
+}
+
+TEST profsy_thread_group_concurrent_register()
+{
+	profsy_setup st( 3 * ( REGISTER_WORKER_SCOPES + 1 ) + 8 );
+	ASSERT( st.mem != 0x0 );
+
+	for( unsigned int i = 0; i < REGISTER_WORKER_SCOPES; ++i )
+		snprintf( register_worker_names[i], sizeof( register_worker_names[i] ), "s%u", i );
+
+	int w1 = profsy_create_thread_ctx( "worker1" );
+	int w2 = profsy_create_thread_ctx( "worker2" );
+	int group = profsy_set_thread_group( w1, "workers" );
+	ASSERT_EQ( group, profsy_set_thread_group( w2, "workers" ) );
+
+	// ... both os-threads register the same paths into the merged tree of the group at the same time ...
+	test_thread_func f1 = { register_worker, w1 };
+	test_thread_func f2 = { register_worker, w2 };
+	test_thread t1 = test_thread_start( &f1 );
+	test_thread t2 = test_thread_start( &f2 );
+	test_thread_join( t1 );
+	test_thread_join( t2 );
+	profsy_swap_frame();
+
+	ASSERT_EQ( 4 * 2 + 3 * ( REGISTER_WORKER_SCOPES + 1 ), profsy_num_active_scopes() );
 
-	ASSERT_EQ( hierarchy[4], hierarchy[6] );
-	s = hierarchy[4]; ASSERT_STR_EQ( s->name,  "overflow scope" ); ASSERT_EQ( s->calls, 2u ); // 2 calls, "s2->s5" and "s3->s5"
+	const profsy_scope_data* last = profsy_get_scope_data( profsy_find_scope( "workers/job.s255" ) );
+	ASSERT( last != 0x0 );
+	ASSERT_EQ( 2u, last->calls );
+
+	static const profsy_scope_data* hierarchy[REGISTER_WORKER_SCOPES + 3];
+	ASSERT_EQ( REGISTER_WORKER_SCOPES + 3, profsy_get_thread_hierarchy( group, hierarchy, REGISTER_WORKER_SCOPES + 3 ) );
+	ASSERT_STR_EQ( "workers", hierarchy[0]->name );
+	ASSERT_STR_EQ( "job",     hierarchy[1]->name );
+	for( unsigned int i = 0; i < REGISTER_WORKER_SCOPES; ++i )
+		ASSERT_EQ( 2u, hierarchy[i + 2]->depth );
+	ASSERT_STR_EQ( "overflow scope", hierarchy[REGISTER_WORKER_SCOPES + 2]->name );
 	return 0;
 }
 
-static void test_frame()
+TEST profsy_frame_domains()
 {
-	{
-		PROFSY_SCOPE("s1");
-		SLEEP(10);
+	profsy_setup st( 64 );
+	ASSERT( st.mem != 0x0 );
 
-		{
-			PROFSY_SCOPE("s2");
-			SLEEP(10);
+	int sim = profsy_create_thread_ctx( "sim" );
+	int sim_domain = profsy_create_frame_domain( "simulation" );
+	ASSERT_EQ( 1, sim_domain );
+	ASSERT_EQ( sim_domain, profsy_set_thread_domain( sim, sim_domain ) );
+	ASSERT_EQ( -1, profsy_set_thread_domain( sim, 7 ) );
 
-			{
-				PROFSY_SCOPE("s3");
-				SLEEP(10);
-			}
-		}
-	}
+	worker_frame( 0, 5 );
+	worker_frame( sim, 10 );
 
+	// ... swapping main domain should not reset the accumulators of simulation ...
+	profsy_swap_frame();
+	worker_frame( sim, 10 );
 	profsy_swap_frame();
+
+	const profsy_scope_data* sim_work = profsy_get_scope_data( profsy_find_scope( "sim/job.work" ) );
+	ASSERT_EQ( 0u, sim_work->calls );
+	ASSERT_EQ( 2u, profsy_get_frame_domain_data( 0 )->frames );
+	ASSERT_EQ( 0u, profsy_get_frame_domain_data( sim_domain )->frames );
+
+	profsy_swap_domain( sim_domain );
+	ASSERT_EQ( 2u,  sim_work->calls );
+	ASSERT_EQ( 20u, sim_work->time );
+	ASSERT_STR_EQ( "simulation", profsy_get_frame_domain_data( sim_domain )->name );
+	ASSERT_EQ( 1u, profsy_get_frame_domain_data( sim_domain )->frames );
+
+	// ... and the other way around ...
+	const profsy_scope_data* main_work = profsy_get_scope_data( profsy_find_scope( "job.work" ) );
+	worker_frame( 0, 5 );
+	profsy_swap_domain( sim_domain );
+	ASSERT_EQ( 0u, sim_work->calls );
+	ASSERT_EQ( 0u, main_work->calls );
+	profsy_swap_domain( 0 );
+	ASSERT_EQ( 1u, main_work->calls );
+	ASSERT_EQ( 3u, profsy_get_frame_domain_data( 0 )->frames );
+	ASSERT_EQ( (const profsy_frame_domain_data*)0x0, profsy_get_frame_domain_data( 2 ) );
+	return 0;
 }
 
-TEST trace_simple()
+TEST profsy_perf_counters()
 {
-	profsy_setup st( 8 );
+	profsy_setup st( 64 );
 	ASSERT( st.mem != 0x0 );
-	// TODO: Trace should start on next swap_frame
 
-	static const int NUM_FRAMES = 3;
-	profsy_trace_entry trace[256];
-	profsy_trace_begin( trace, (unsigned int)ARRAY_LENGTH(trace), NUM_FRAMES );
+	// ... opening counters might fail depending on platform and permissions, scopes should work anyway ...
+	int num_counters = profsy_perf_counters_enable( 0 );
+	ASSERT_EQ( (const char*)0x0, profsy_perf_counter_name( 0, PROFSY_PERF_COUNTERS_MAX ) );
 
-	ASSERT_FALSE( profsy_is_tracing() );
+	volatile uint64_t sum = 0;
+	{
+		PROFSY_SCOPE( "work" );
+		for( unsigned int i = 0; i < 100000; ++i )
+			sum += i;
+	}
 	profsy_swap_frame();
 
-	for( int i = 0; i < NUM_FRAMES; ++i )
+	const profsy_scope_data* work = profsy_get_scope_data( profsy_find_scope( "work" ) );
+	ASSERT_EQ( 1u, work->calls );
+	if( num_counters <= 0 )
 	{
-		ASSERT( profsy_is_tracing() );
-		test_frame();
+		ASSERT_EQ( (const char*)0x0, profsy_perf_counter_name( 0, 0 ) );
+		ASSERT_EQ( 0u, work->perf_counters[0] );
+	}
+	else
+	{
+		ASSERT( profsy_perf_counter_name( 0, (unsigned int)num_counters - 1 ) != 0x0 );
+		if( strcmp( profsy_perf_counter_name( 0, 0 ), "instructions" ) == 0 )
+			ASSERT( work->perf_counters[0] > 100000u );
 	}
-	ASSERT_FALSE( profsy_is_tracing() );
 
-	uint64_t last_ts = 0;
+	profsy_perf_counters_disable( 0 );
+	ASSERT_EQ( (const char*)0x0, profsy_perf_counter_name( 0, 0 ) );
+	return 0;
+}
 
-	// check all timestamps
-	for( int i = 0; i < NUM_FRAMES; ++i )
+TEST profsy_scope_sched_info()
+{
+	profsy_setup st( 64 );
+	ASSERT( st.mem != 0x0 );
+
+	scoped_func1();
+	int scope = profsy_find_scope( "scoped_func1" );
+	ASSERT_EQ( 0u, profsy_get_scope_flags( scope ) );
+	ASSERT_EQ( 0,  profsy_set_scope_flags( scope, PROFSY_SCOPE_FLAG_SCHED_INFO ) );
+	ASSERT_EQ( -1, profsy_set_scope_flags( 63, PROFSY_SCOPE_FLAG_SCHED_INFO ) );
+	ASSERT_EQ( PROFSY_SCOPE_FLAG_SCHED_INFO, profsy_get_scope_flags( scope ) );
+	profsy_swap_frame();
+
+	// ... scoped_func1 sleeps so there should be at least one voluntary switch ...
+	scoped_func1();
+	scoped_func1();
+	profsy_swap_frame();
+
+	const profsy_scope_data* data = profsy_get_scope_data( scope );
+	ASSERT_EQ( 2u, data->calls );
+	ASSERT( data->preempted <= data->calls );
+#if defined( __linux__ )
+	ASSERT( data->context_switches >= 2u );
+#endif
+	return 0;
+}
+
+TEST profsy_sampling()
+{
+	profsy_setup st( 64 );
+	ASSERT( st.mem != 0x0 );
+
+	ASSERT_EQ( -1, profsy_sampling_enable( 0, 0 ) );
+	if( profsy_sampling_enable( 0, 1000000 ) != 0 )
+		SKIPm( "sampling not supported" );
+
+	// ... burn cpu-time in scope, samples are taken on thread cpu-time ...
 	{
-		profsy_trace_entry* e = trace + ( i * 8 + 0 );
-		ASSERT( e->ts > last_ts );
-		last_ts  = e->ts;
+		PROFSY_SCOPE( "busy" );
+		volatile uint64_t sum = 0;
+		for( clock_t start = clock(); clock() - start < CLOCKS_PER_SEC / 20; )
+			sum += 1;
 	}
+	profsy_perf_counters_disable( 0 ); // ... does not touch samples taken ...
+	profsy_sampling_disable( 0 );
+	profsy_swap_frame();
 
-	uint16_t root_scope_id = (uint16_t)profsy_find_scope( "" );
-	uint16_t s1_scope_id   = (uint16_t)profsy_find_scope( "s1" );
-	uint16_t s2_scope_id   = (uint16_t)profsy_find_scope( "s1.s2" );
-	uint16_t s3_scope_id   = (uint16_t)profsy_find_scope( "s1.s2.s3" );
+	const profsy_scope_data* busy = profsy_get_scope_data( profsy_find_scope( "busy" ) );
+	ASSERT( busy->samples > 0u );
+	ASSERT( busy->samples <= PROFSY_SAMPLES_MAX );
 
-	ASSERT_EQ( 0u, root_scope_id );
-	ASSERT_EQ( 2u, s1_scope_id );
-	ASSERT_EQ( 3u, s2_scope_id );
-	ASSERT_EQ( 4u, s3_scope_id );
+	profsy_swap_frame();
+	ASSERT_EQ( 0u, busy->samples );
+	return 0;
+}
 
-	struct
+TEST profsy_overhead_calibration()
+{
+	profsy_setup st( 64 );
+	ASSERT( st.mem != 0x0 );
+
+	uint64_t overhead = profsy_calibrate_overhead( 1000 );
+	ASSERT( overhead > 0u );
+
+	int overhead_scope = profsy_find_scope( "profiler overhead" );
+	ASSERT( overhead_scope >= 0 );
+
+	// ... parent with 3 children, each child with 2 children of its own, all with fixed times ...
+	int parent = profsy_scope_enter( "parent", 0 );
+	for( int i = 0; i < 3; ++i )
 	{
-		uint16_t event;
-		uint16_t scope;
-	} expect[] = {
-		{ PROFSY_TRACE_EVENT_ENTER, root_scope_id },
-		{ PROFSY_TRACE_EVENT_ENTER, s1_scope_id   },
-		{ PROFSY_TRACE_EVENT_ENTER, s2_scope_id   },
-		{ PROFSY_TRACE_EVENT_ENTER, s3_scope_id   },
+		int child = profsy_scope_enter( "child", 0 );
+		for( int j = 0; j < 2; ++j )
+			profsy_scope_leave( profsy_scope_enter( "leaf", 0 ), 0, 1000 );
+		profsy_scope_leave( child, 0, 10000 );
+	}
+	profsy_scope_leave( parent, 0, 100000 );
+	profsy_swap_frame();
 
-		{ PROFSY_TRACE_EVENT_LEAVE, s3_scope_id   },
-		{ PROFSY_TRACE_EVENT_LEAVE, s2_scope_id   },
-		{ PROFSY_TRACE_EVENT_LEAVE, s1_scope_id   },
-		{ PROFSY_TRACE_EVENT_LEAVE, root_scope_id },
-	};
+	// ... calibration-loop is not reported, but estimated overhead of all calls in frame is ...
+	const profsy_scope_data* od = profsy_get_scope_data( overhead_scope );
+	ASSERT_EQ( 10u, od->calls );
+	ASSERT_EQ( 10u * overhead, od->time );
 
-	for( int i = 0; i < NUM_FRAMES; ++i )
+	const profsy_scope_data* pd = profsy_get_scope_data( profsy_find_scope( "parent" ) );
+	ASSERT_EQ( 100000u, pd->time );
+	ASSERT_EQ( 30000u,  pd->child_time );
+
+	profsy_subtract_overhead( true );
+	parent = profsy_scope_enter( "parent", 0 );
+	for( int i = 0; i < 3; ++i )
 	{
-		for( int j = 0; j < (int)ARRAY_LENGTH( expect ); ++j )
-		{
-			profsy_trace_entry* e = trace + ( i * 8 + j );
-			ASSERT_EQ( e->event, expect[j].event );
-			ASSERT_EQ( e->scope, expect[j].scope );
-		}
+		int child = profsy_scope_enter( "child", 0 );
+		for( int j = 0; j < 2; ++j )
+			profsy_scope_leave( profsy_scope_enter( "leaf", 0 ), 0, 1000 );
+		profsy_scope_leave( child, 0, 10000 );
 	}
+	profsy_scope_leave( parent, 0, 100000 );
+	profsy_swap_frame();
 
-	ASSERT_EQ( trace[ NUM_FRAMES * 8 + 1 ].event, PROFSY_TRACE_EVENT_END ); // check end of trace-marker
+	uint64_t child_overhead = 6 * overhead < 30000 ? 6 * overhead : 30000;
+	uint64_t time_overhead  = 9 * overhead < 100000 ? 9 * overhead : 100000;
+	ASSERT_EQ( 100000u - time_overhead, pd->time );
+	ASSERT_EQ( 30000u - child_overhead, pd->child_time );
+	return 0;
+}
+
+TEST profsy_overhead_name_self_time()
+{
+	profsy_setup st( 64 );
+	ASSERT( st.mem != 0x0 );
+	ASSERT( profsy_calibrate_overhead( 100 ) > 0u );
+	profsy_subtract_overhead( true );
+
+	// ... scopes without self-time, subtracting the overhead of the calls below them leaves time below child_time ...
+	int outer = profsy_scope_enter( "outer", 0 );
+	int inner = profsy_scope_enter( "inner", 0 );
+	profsy_scope_leave( profsy_scope_enter( "leaf", 0 ), 0, 1000000 );
+	profsy_scope_leave( inner, 0, 1000000 );
+	profsy_scope_leave( outer, 0, 1000000 );
+	profsy_swap_frame();
+
+	const profsy_scope_data* od = profsy_get_scope_data( profsy_find_scope( "outer" ) );
+	ASSERT( od->time < od->child_time );
 
+	const profsy_name_data* names[16];
+	unsigned int num_names = profsy_get_name_data( names, 16 );
+	for( unsigned int i = 0; i < num_names; ++i )
+	{
+		if( strcmp( names[i]->name, "outer" ) == 0 || strcmp( names[i]->name, "inner" ) == 0 )
+			ASSERT_EQ( 0u, names[i]->self_time );
+	}
 	return 0;
 }
 
-TEST trace_overflow()
+static void budget_frame()
 {
-	profsy_setup st( 8 );
+	int parent = profsy_scope_enter( "parent", 0 );
+	for( int i = 0; i < 1000; ++i )
+		profsy_scope_leave( profsy_scope_enter( "tiny", 0 ), 0, 0 );
+	profsy_scope_leave( profsy_scope_enter( "big", 0 ), 0, 1000000000 );
+	profsy_scope_leave( parent, 0, 1000000000 );
+}
+
+TEST profsy_overhead_budget()
+{
+	profsy_setup st( 64 );
 	ASSERT( st.mem != 0x0 );
 
-	profsy_trace_entry trace[4];
-	profsy_trace_begin( trace, (unsigned int)ARRAY_LENGTH(trace), 2 );
+	budget_frame();
+	int parent = profsy_find_scope( "parent" );
+	int tiny   = profsy_find_scope( "parent.tiny" );
+	ASSERT_EQ( -1, profsy_set_scope_mode( parent, PROFSY_SCOPE_MODE_OFF ) );
 
-	ASSERT_FALSE( profsy_is_tracing() );
+	// ... count-only scopes count calls but are not timed ...
+	ASSERT_EQ( 0, profsy_set_scope_mode( tiny, PROFSY_SCOPE_MODE_COUNT_ONLY ) );
 	profsy_swap_frame();
+	budget_frame();
+	profsy_swap_frame();
+	const profsy_scope_data* tiny_data = profsy_get_scope_data( tiny );
+	ASSERT_EQ( PROFSY_SCOPE_MODE_COUNT_ONLY, tiny_data->mode );
+	ASSERT_EQ( 1000u, tiny_data->calls );
+	ASSERT_EQ( 0u,    tiny_data->time );
+	ASSERT_EQ( 1u,    profsy_get_scope_data( profsy_find_scope( "parent.big" ) )->calls );
+
+	// ... over budget, cheap scopes are turned off but not expensive ones ...
+	ASSERT_EQ( 0, profsy_set_scope_mode( tiny, PROFSY_SCOPE_MODE_FULL ) );
+	ASSERT( profsy_calibrate_overhead( 100 ) > 0u );
+	profsy_set_overhead_budget( 1 );
+	budget_frame();
+	profsy_swap_frame();
+	ASSERT_EQ( PROFSY_SCOPE_MODE_OFF,  tiny_data->mode );
+	ASSERT_EQ( PROFSY_SCOPE_MODE_FULL, profsy_get_scope_data( profsy_find_scope( "parent.big" ) )->mode );
+	ASSERT_EQ( PROFSY_SCOPE_MODE_FULL, profsy_get_scope_data( parent )->mode );
 
-	ASSERT( profsy_is_tracing() );
+	budget_frame();
+	profsy_swap_frame();
+	ASSERT_EQ( 0u, tiny_data->calls );
+	ASSERT_EQ( 1u, profsy_get_scope_data( parent )->calls );
+	return 0;
+}
 
-	test_frame();
+TEST profsy_loop_scopes()
+{
+	profsy_setup st( 64 );
+	ASSERT( st.mem != 0x0 );
+
+	volatile uint64_t sum = 0;
+	{
+		PROFSY_SCOPE( "update" );
+		{
+			PROFSY_SCOPE_LOOP( particles, "particle" );
+			for( unsigned int i = 0; i < 1000; ++i )
+			{
+				PROFSY_SCOPE_LOOP_ITER( particles );
+				sum += i;
+			}
+
+			// ... nothing is registered until the loop-scope goes out of scope ...
+			ASSERT_EQ( -1, profsy_find_scope( "update.particle" ) );
+		}
+
+		PROFSY_SCOPE_LOOP_SAMPLED( vertices, "vertex", 16 );
+		for( unsigned int i = 0; i < 100; ++i )
+		{
+			PROFSY_SCOPE_LOOP_ITER( vertices );
+			sum += i;
+		}
+		ASSERT_EQ( 7u, vertices.sampled );
+	}
 	profsy_swap_frame();
 
-	ASSERT_FALSE( profsy_is_tracing() ); // this should be false after one frame since it would have overflowed already
+	const profsy_scope_data* update   = profsy_get_scope_data( profsy_find_scope( "update" ) );
+	const profsy_scope_data* particle = profsy_get_scope_data( profsy_find_scope( "update.particle" ) );
+	const profsy_scope_data* vertex   = profsy_get_scope_data( profsy_find_scope( "update.vertex" ) );
+	ASSERT_EQ( 1000u, particle->calls );
+	ASSERT_EQ( 100u,  vertex->calls );
+	ASSERT_EQ( particle->time + vertex->time, update->child_time );
+	ASSERT( update->time >= update->child_time );
 
-	ASSERT_EQ( PROFSY_TRACE_EVENT_OVERFLOW, trace[ ARRAY_LENGTH(trace) - 1 ].event );
+	// ... explicit adds ...
+	{
+		PROFSY_SCOPE( "update" );
+		profsy_scope_add( "particle", 10, 500 );
+	}
+	profsy_swap_frame();
+	ASSERT_EQ( 10u,  particle->calls );
+	ASSERT_EQ( 500u, particle->time );
+	ASSERT_EQ( 500u, update->child_time );
+	return 0;
+}
+
+static void recursive_ticks( int depth, uint64_t start, uint64_t end )
+{
+	int id = profsy_scope_enter( "recursive", start );
+	if( depth > 0 )
+		recursive_ticks( depth - 1, start + 1, end - 1 );
+	profsy_scope_leave( id, start, end );
+}
+
+TEST profsy_collapse_recursion()
+{
+	profsy_setup st( 64 );
+	ASSERT( st.mem != 0x0 );
+
+	recursive_ticks( 0, 0, 100 );
+	int recursive = profsy_find_scope( "recursive" );
+	ASSERT_EQ( 0, profsy_set_scope_flags( recursive, PROFSY_SCOPE_FLAG_COLLAPSE_RECURSION ) );
+	profsy_swap_frame();
+
+	unsigned int num_scopes = profsy_num_active_scopes();
+	recursive_ticks( 20, 0, 100 );
+	{
+		// ... only direct recursion is collapsed ...
+		int id = profsy_scope_enter( "recursive", 0 );
+		scoped_func1();
+		profsy_scope_leave( id, 0, 100 );
+	}
+	profsy_swap_frame();
+
+	ASSERT_EQ( num_scopes + 1, profsy_num_active_scopes() );
+	ASSERT_EQ( -1, profsy_find_scope( "recursive.recursive" ) );
+	ASSERT( profsy_find_scope( "recursive.scoped_func1" ) >= 0 );
+
+	const profsy_scope_data* data = profsy_get_scope_data( recursive );
+	ASSERT_EQ( 22u,  data->calls );
+	ASSERT_EQ( 200u, data->time );
+	ASSERT_EQ( 1u,   data->num_sub_scopes );
+	return 0;
+}
+
+TEST profsy_stable_path_hashes()
+{
+	profsy_setup st( 64 );
+	ASSERT( st.mem != 0x0 );
+
+	int render = profsy_create_thread_ctx( "render" );
+	{
+		PROFSY_SCOPE( "parent_scope1" );
+		scoped_func1();
+	}
+	profsy_scope_leave_thread( render, profsy_scope_enter_thread( render, "draw", 0 ), 0, 1 );
+	profsy_swap_frame();
+
+	// ... hashes only depend on the names in the path, not on registration-order ...
+	int scope = profsy_find_scope( "parent_scope1.scoped_func1" );
+	const profsy_scope_data* data = profsy_get_scope_data( scope );
+	ASSERT_EQ( profsy_path_hash( "parent_scope1.scoped_func1" ), data->path_hash );
+	ASSERT_EQ( profsy_path_hash( "main/parent_scope1.scoped_func1" ), data->path_hash );
+	ASSERT_EQ( scope, profsy_find_scope_by_hash( data->path_hash ) );
+	ASSERT_EQ( profsy_find_scope( "render/draw" ), profsy_find_scope_by_hash( profsy_path_hash( "render/draw" ) ) );
+	ASSERT_EQ( -1, profsy_find_scope_by_hash( profsy_path_hash( "render/not_registered" ) ) );
+	ASSERT( profsy_path_hash( "main/" ) != profsy_path_hash( "render/" ) );
+
+#if PROFSY_HAS_CONSTEXPR
+	// ... name-hashes is computed at compile-time and can be used in constant expressions ...
+	static_assert( __profsy_hash_name( "" ) == 0xcbf29ce484222325ULL, "fnv1a offset" );
+	static_assert( __profsy_hash_name( "a" ) == 0xaf63dc4c8601ec8cULL, "fnv1a of 'a'" );
+#endif
+
+	// ... entering by hash finds the same scope as entering by name ...
+	unsigned int num_scopes = profsy_num_active_scopes();
+	{
+		PROFSY_SCOPE( "parent_scope1" );
+		static const char other_name[] = "scoped_func1"; // same name, other pointer.
+		profsy_scope_leave( profsy_scope_enter_hashed( other_name, __profsy_hash_name( other_name ), 0 ), 0, 1 );
+	}
+	profsy_swap_frame();
+	ASSERT_EQ( num_scopes, profsy_num_active_scopes() );
+	ASSERT_EQ( 1u, data->calls );
+	return 0;
+}
+
+TEST profsy_fiber_suspended_time()
+{
+	profsy_setup st( 256 );
+	ASSERT( st.mem != 0x0 );
+
+	int fiber = profsy_create_fiber_ctx( "fiber" );
+	int os_thread = profsy_create_thread_ctx( "os-thread" );
+	ASSERT( fiber > 0 );
+
+	// start on main, suspend and resume on another os-thread.
+	ASSERT_EQ( 0, profsy_fiber_switch( fiber, 0 ) );
+	int id = profsy_scope_enter( "task", 0 );
+	ASSERT_EQ( fiber, profsy_fiber_switch( 0, 10 ) );
+
+	profsy_set_thread_ctx( os_thread );
+	ASSERT_EQ( os_thread, profsy_fiber_switch( fiber, 40 ) );
+	profsy_scope_leave( id, 0, 50 );
+	ASSERT_EQ( fiber, profsy_fiber_switch( os_thread, 50 ) );
+	profsy_set_thread_ctx( 0 );
+
+	profsy_swap_frame();
+
+	const profsy_scope_data* task = profsy_get_scope_data( profsy_find_scope( "fiber/task" ) );
+	ASSERT( task != 0x0 );
+	ASSERT_EQ( 1u,  task->calls );
+	ASSERT_EQ( 20u, task->time );
+	ASSERT_EQ( 30u, task->suspended_time );
+	ASSERT_EQ( -1, profsy_find_scope( "os-thread/task" ) );
+	return 0;
+}
+
+TEST profsy_out_of_resources_is_tracked()
+{
+	profsy_setup st( 4 );
+	ASSERT( st.mem != 0x0 );
+	{
+		PROFSY_SCOPE("s1");
+		PROFSY_SCOPE("s2");
+		PROFSY_SCOPE("s3");
+		PROFSY_SCOPE("s4");
+		PROFSY_SCOPE("s5"); // this scope will overflow...
+		PROFSY_SCOPE("s6"); // this scope will overflow...
+	}
+
+	profsy_swap_frame();
+	ASSERT_EQ( 6u, profsy_num_active_scopes() ); // max amount of scopes active...
+
+	const profsy_scope_data* hierarchy[16];
+	profsy_get_scope_hierarchy( hierarchy, 16 );
+
+	const profsy_scope_data* s;
+	s = hierarchy[0];
+	ASSERT_STR_EQ( s->name,  "main" );
+	ASSERT_EQ    ( s->calls, 1u );
+
+	s = hierarchy[1]; ASSERT_STR_EQ( s->name,  "s1" ); ASSERT_EQ( s->calls, 1u );
+	s = hierarchy[2]; ASSERT_STR_EQ( s->name,  "s2" ); ASSERT_EQ( s->calls, 1u );
+	s = hierarchy[3]; ASSERT_STR_EQ( s->name,  "s3" ); ASSERT_EQ( s->calls, 1u );
+	s = hierarchy[4]; ASSERT_STR_EQ( s->name,  "s4" ); ASSERT_EQ( s->calls, 1u );
+
+	s = hierarchy[5];
+	ASSERT_STR_EQ( s->name,  "overflow scope" );
+	ASSERT_EQ    ( s->calls, 2u ); // 2 calls, "s3" and "s4"
+	return 0;
+}
+
+TEST profsy_overflow_names_are_tracked()
+{
+	profsy_setup st( 4 );
+	ASSERT( st.mem != 0x0 );
+	{
+		PROFSY_SCOPE("s1");
+		PROFSY_SCOPE("s2");
+		PROFSY_SCOPE("s3");
+		PROFSY_SCOPE("s4");
+		{ PROFSY_SCOPE("s5"); } // this scope will overflow...
+		{ PROFSY_SCOPE("s5"); } // this scope will overflow, but on the same name...
+		{ PROFSY_SCOPE("s6"); } // this scope will overflow...
+	}
+
+	profsy_swap_frame();
+
+	const profsy_scope_data* overflowed[16];
+	ASSERT_EQ( 2u, profsy_get_overflow_scopes( 0, overflowed, 16 ) );
+	ASSERT_STR_EQ( overflowed[0]->name, "s5" ); ASSERT_EQ( overflowed[0]->calls, 2u );
+	ASSERT_STR_EQ( overflowed[1]->name, "s6" ); ASSERT_EQ( overflowed[1]->calls, 1u );
+	ASSERT_EQ( 1u, profsy_get_overflow_scopes( 0, overflowed, 1 ) );
+	ASSERT_EQ( 0u, profsy_get_overflow_scopes( 1, overflowed, 16 ) );
+
+	// overflowed names are reported after the overflow-scope in the hierarchy.
+	const profsy_scope_data* hierarchy[16];
+	profsy_get_scope_hierarchy( hierarchy, 16 );
+	ASSERT_STR_EQ( hierarchy[5]->name, "overflow scope" ); ASSERT_EQ( hierarchy[5]->calls, 3u );
+	ASSERT_EQ( hierarchy[6], overflowed[0] );
+	ASSERT_EQ( hierarchy[7], overflowed[1] );
+	ASSERT_EQ( hierarchy[6]->depth, hierarchy[5]->depth + 1 );
+	return 0;
+}
+
+TEST profsy_overflow_names_under_nested_parent()
+{
+	profsy_setup st( 2 );
+	ASSERT( st.mem != 0x0 );
+	{
+		PROFSY_SCOPE("a");
+		{
+			PROFSY_SCOPE("x");
+			{ PROFSY_SCOPE("o1"); } // this scope will overflow under "a/x"...
+			{ PROFSY_SCOPE("o1"); } // ... on the same name...
+		}
+		{ PROFSY_SCOPE("o2"); } // ... and this under "a"
+	}
+	profsy_swap_frame();
+
+	const profsy_scope_data* overflowed[16];
+	ASSERT_EQ( 2u, profsy_get_overflow_scopes( 0, overflowed, 16 ) );
+	ASSERT_STR_EQ( overflowed[0]->name, "o1" ); ASSERT_EQ( overflowed[0]->calls, 2u );
+	ASSERT_STR_EQ( overflowed[1]->name, "o2" ); ASSERT_EQ( overflowed[1]->calls, 1u );
+
+	const profsy_scope_data* hierarchy[16];
+	ASSERT_EQ( 6u, profsy_get_scope_hierarchy( hierarchy, 16 ) );
+	ASSERT_STR_EQ( hierarchy[3]->name, "overflow scope" ); ASSERT_EQ( hierarchy[3]->calls, 3u );
+	ASSERT_EQ( hierarchy[4], overflowed[0] );
+	ASSERT_EQ( hierarchy[5], overflowed[1] );
+	ASSERT_EQ( hierarchy[4]->depth, hierarchy[3]->depth + 1 );
+	ASSERT_EQ( hierarchy[5]->depth, hierarchy[3]->depth + 1 );
+	return 0;
+}
+
+TEST profsy_overflow_under_nested_parents()
+{
+	// ... the thread is registered first so its tree is moved by every scope registered in "main" ...
+	profsy_setup st( 5 );
+	ASSERT( st.mem != 0x0 );
+	int other = profsy_create_thread_ctx( "other" );
+	ASSERT( other > 0 );
+
+	for( int frame = 0; frame < 2; ++frame )
+	{
+		{
+			PROFSY_SCOPE("a");
+			PROFSY_SCOPE("x");
+			if( frame > 0 )
+			{
+				PROFSY_SCOPE("o1"); // this scope will overflow under "a/x"...
+			}
+		}
+		{
+			PROFSY_SCOPE("b");
+			if( frame > 0 )
+			{
+				PROFSY_SCOPE("o2"); // ... and this under "b"
+			}
+		}
+		profsy_swap_frame();
+	}
+
+	const profsy_scope_data* hierarchy[16];
+	ASSERT_EQ( 9u, profsy_get_scope_hierarchy( hierarchy, 16 ) );
+	ASSERT_STR_EQ( hierarchy[4]->name, "overflow scope" ); ASSERT_EQ( hierarchy[4]->calls, 2u );
+	ASSERT_STR_EQ( hierarchy[5]->name, "o1" );
+	ASSERT_STR_EQ( hierarchy[6]->name, "o2" );
+	ASSERT_STR_EQ( hierarchy[7]->name, "other" );
+
+	const profsy_scope_data* thread_scopes[16];
+	ASSERT_EQ( 7u, profsy_get_thread_hierarchy( 0, thread_scopes, 16 ) );
+	ASSERT_STR_EQ( thread_scopes[0]->name, "main" );
+	ASSERT_EQ( 2u, profsy_get_thread_hierarchy( other, thread_scopes, 16 ) );
+	ASSERT_STR_EQ( thread_scopes[0]->name, "other" );
+	ASSERT_STR_EQ( thread_scopes[1]->name, "overflow scope" );
+	return 0;
+}
+
+// register more scopes than fit in 16 bits, depth-first to keep the hierarchy-inserts at the end.
+static const unsigned int WIDE_TREE_FANOUT = 256;
+static char wide_tree_names[WIDE_TREE_FANOUT][8];
+
+static void register_wide_tree()
+{
+	for( unsigned int i = 0; i < WIDE_TREE_FANOUT; ++i )
+		snprintf( wide_tree_names[i], sizeof( wide_tree_names[i] ), "s%u", i );
+
+	for( unsigned int i = 0; i < WIDE_TREE_FANOUT; ++i )
+	{
+		int parent = profsy_scope_enter( wide_tree_names[i], 0 );
+		for( unsigned int j = 0; j < WIDE_TREE_FANOUT; ++j )
+			profsy_scope_leave( profsy_scope_enter( wide_tree_names[j], 0 ), 0, 1 );
+		profsy_scope_leave( parent, 0, 1 );
+	}
+}
+
+TEST profsy_wide_sub_scope_count()
+{
+	profsy_setup st( 16 + WIDE_TREE_FANOUT * ( WIDE_TREE_FANOUT + 1 ) );
+	ASSERT( st.mem != 0x0 );
+	register_wide_tree();
+	profsy_swap_frame();
+
+	ASSERT_EQ( WIDE_TREE_FANOUT * ( WIDE_TREE_FANOUT + 1 ), profsy_get_scope_data( 0 )->num_sub_scopes );
+	ASSERT_EQ( WIDE_TREE_FANOUT, profsy_get_scope_data( profsy_find_scope( "s0" ) )->num_sub_scopes );
+	return 0;
+}
+
+static void test_it( bool do_scope )
+{
+	if( do_scope )
+	{
+		PROFSY_SCOPE( "s5" );
+	}
+}
+
+TEST profsy_multi_overflow()
+{
+	profsy_setup st( 4 );
+	ASSERT( st.mem != 0x0 );
+	{
+		for( int i = 0; i < 2; ++i )
+		{
+			{ PROFSY_SCOPE("s1"); test_it( i > 0 ); }
+			{ PROFSY_SCOPE("s2"); test_it( i > 0 ); }
+			{ PROFSY_SCOPE("s3"); test_it( i > 0 ); }
+		}
+	}
+
+	profsy_swap_frame();
+	ASSERT_EQ( 6u, profsy_num_active_scopes() ); // max amount of scopes active...
+
+	const profsy_scope_data* hierarchy[16];
+	profsy_get_scope_hierarchy( hierarchy, 16 );
+
+	const profsy_scope_data* s;
+	s = hierarchy[0]; ASSERT_STR_EQ( s->name, "main" ); ASSERT_EQ( s->calls, 1u );
+	s = hierarchy[1]; ASSERT_STR_EQ( s->name,   "s1" ); ASSERT_EQ( s->calls, 2u );
+	s = hierarchy[2]; ASSERT_STR_EQ( s->name,   "s5" ); ASSERT_EQ( s->calls, 1u );
+	s = hierarchy[3]; ASSERT_STR_EQ( s->name,   "s2" ); ASSERT_EQ( s->calls, 2u );
+	s = hierarchy[4]; ASSERT_STR_EQ( s->name,   "s3" ); ASSERT_EQ( s->calls, 2u );
+
+	// the overflow-scope is listed once, after the thread-tree.
+	s = hierarchy[5]; ASSERT_STR_EQ( s->name,  "overflow scope" ); ASSERT_EQ( s->calls, 2u ); // 2 calls, "s2->s5" and "s3->s5"
+	ASSERT_EQ( s->depth, 1u );
+	return 0;
+}
+
+TEST profsy_overflow_is_listed_once()
+{
+	profsy_setup st( 2 );
+	ASSERT( st.mem != 0x0 );
+	{
+		PROFSY_SCOPE("a");
+		{ PROFSY_SCOPE("x"); }
+		{ PROFSY_SCOPE("o1"); } // this scope will overflow under "a"...
+		{
+			PROFSY_SCOPE("x");
+			PROFSY_SCOPE("o2"); // ... and this under "a/x"
+		}
+	}
+	profsy_swap_frame();
+
+	const profsy_scope_data* hierarchy[16];
+	unsigned int num_scopes = profsy_get_scope_hierarchy( hierarchy, 16 );
+	ASSERT_EQ( 6u, num_scopes );
+	ASSERT_STR_EQ( hierarchy[0]->name, "main" );           ASSERT_EQ( hierarchy[0]->depth, 0u );
+	ASSERT_STR_EQ( hierarchy[1]->name, "a" );              ASSERT_EQ( hierarchy[1]->depth, 1u );
+	ASSERT_STR_EQ( hierarchy[2]->name, "x" );              ASSERT_EQ( hierarchy[2]->depth, 2u );
+	ASSERT_STR_EQ( hierarchy[3]->name, "overflow scope" ); ASSERT_EQ( hierarchy[3]->depth, 1u ); ASSERT_EQ( hierarchy[3]->calls, 2u );
+
+	// ... a valid depth-first order never steps down more than one level at a time ...
+	for( unsigned int i = 1; i < num_scopes; ++i )
+		ASSERT( hierarchy[i]->depth <= hierarchy[i - 1]->depth + 1 );
+	return 0;
+}
+
+static void test_frame()
+{
+	{
+		PROFSY_SCOPE("s1");
+		SLEEP(10);
+
+		{
+			PROFSY_SCOPE("s2");
+			SLEEP(10);
+
+			{
+				PROFSY_SCOPE("s3");
+				SLEEP(10);
+			}
+		}
+	}
+
+	profsy_swap_frame();
+}
+
+TEST trace_simple()
+{
+	profsy_setup st( 8 );
+	ASSERT( st.mem != 0x0 );
+	// TODO: Trace should start on next swap_frame
+
+	static const int NUM_FRAMES = 3;
+	profsy_trace_entry trace[256];
+	profsy_trace_begin( trace, (unsigned int)ARRAY_LENGTH(trace), NUM_FRAMES );
+
+	ASSERT_FALSE( profsy_is_tracing() );
+	profsy_swap_frame();
+
+	for( int i = 0; i < NUM_FRAMES; ++i )
+	{
+		ASSERT( profsy_is_tracing() );
+		test_frame();
+	}
+	ASSERT_FALSE( profsy_is_tracing() );
+
+	uint64_t last_ts = 0;
+
+	// check all timestamps
+	for( int i = 0; i < NUM_FRAMES; ++i )
+	{
+		profsy_trace_entry* e = trace + ( i * 8 + 0 );
+		ASSERT( e->ts > last_ts );
+		last_ts  = e->ts;
+	}
+
+	uint32_t root_scope_id = (uint32_t)profsy_find_scope( "" );
+	uint32_t s1_scope_id   = (uint32_t)profsy_find_scope( "s1" );
+	uint32_t s2_scope_id   = (uint32_t)profsy_find_scope( "s1.s2" );
+	uint32_t s3_scope_id   = (uint32_t)profsy_find_scope( "s1.s2.s3" );
+
+	ASSERT_EQ( 0u, root_scope_id );
+	ASSERT_EQ( 2u, s1_scope_id );
+	ASSERT_EQ( 3u, s2_scope_id );
+	ASSERT_EQ( 4u, s3_scope_id );
+
+	struct
+	{
+		uint16_t event;
+		uint32_t scope;
+	} expect[] = {
+		{ PROFSY_TRACE_EVENT_ENTER, root_scope_id },
+		{ PROFSY_TRACE_EVENT_ENTER, s1_scope_id   },
+		{ PROFSY_TRACE_EVENT_ENTER, s2_scope_id   },
+		{ PROFSY_TRACE_EVENT_ENTER, s3_scope_id   },
+
+		{ PROFSY_TRACE_EVENT_LEAVE, s3_scope_id   },
+		{ PROFSY_TRACE_EVENT_LEAVE, s2_scope_id   },
+		{ PROFSY_TRACE_EVENT_LEAVE, s1_scope_id   },
+		{ PROFSY_TRACE_EVENT_LEAVE, root_scope_id },
+	};
+
+	for( int i = 0; i < NUM_FRAMES; ++i )
+	{
+		for( int j = 0; j < (int)ARRAY_LENGTH( expect ); ++j )
+		{
+			profsy_trace_entry* e = trace + ( i * 8 + j );
+			ASSERT_EQ( e->event, expect[j].event );
+			ASSERT_EQ( e->scope, expect[j].scope );
+		}
+	}
+
+	ASSERT_EQ( trace[ NUM_FRAMES * 8 + 1 ].event, PROFSY_TRACE_EVENT_END ); // check end of trace-marker
+
+	return 0;
+}
+
+TEST trace_overflow()
+{
+	profsy_setup st( 8 );
+	ASSERT( st.mem != 0x0 );
+
+	profsy_trace_entry trace[4];
+	profsy_trace_begin( trace, (unsigned int)ARRAY_LENGTH(trace), 2 );
+
+	ASSERT_FALSE( profsy_is_tracing() );
+	profsy_swap_frame();
+
+	ASSERT( profsy_is_tracing() );
+
+	test_frame();
+	profsy_swap_frame();
+
+	ASSERT_FALSE( profsy_is_tracing() ); // this should be false after one frame since it would have overflowed already
+
+	ASSERT_EQ( PROFSY_TRACE_EVENT_OVERFLOW, trace[ ARRAY_LENGTH(trace) - 1 ].event );
+	return 0;
+}
+
+static void counted_func( int draw_calls )
+{
+	PROFSY_COUNTER( "draw calls", draw_calls );
+	PROFSY_GAUGE( "entities", draw_calls * 10 );
+}
+
+// read all written to f into buffer and close f.
+static char* read_dump( FILE* f, char* buffer, size_t buffer_size )
+{
+	rewind( f );
+	size_t read = fread( buffer, 1, buffer_size - 1, f );
+	fclose( f );
+	buffer[read] = '\0';
+	return buffer;
+}
+
+// dump trace in format to a string, return 0 on failure.
+static char* dump_trace( profsy_trace_entry* trace, unsigned int format, char* buffer, size_t buffer_size )
+{
+	FILE* f = tmpfile();
+	if( f == 0x0 )
+		return 0x0;
+	profsy_util_dump_to_stream( f, trace, format );
+	return read_dump( f, buffer, buffer_size );
+}
+
+// dump trace in chrome-format to a string, return 0 on failure.
+static char* dump_chrome_trace( profsy_trace_entry* trace, char* buffer, size_t buffer_size )
+{
+	return dump_trace( trace, PROFSY_UTIL_DUMP_FORMAT_CHROME, buffer, buffer_size );
+}
+
+TEST profsy_counters()
+{
+	profsy_setup st( 8 );
+	ASSERT( st.mem != 0x0 );
+
+	counted_func( 1 );
+	counted_func( 2 );
+	ASSERT_EQ( 2u, profsy_num_counters() );
+
+	int uploaded = profsy_counter_register( "bytes uploaded", PROFSY_COUNTER_TYPE_COUNTER );
+	ASSERT_EQ( 2, uploaded );
+	ASSERT_EQ( uploaded, profsy_counter_register( "bytes uploaded", PROFSY_COUNTER_TYPE_COUNTER ) );
+	static char uploaded_copy[] = "bytes uploaded";
+	ASSERT_EQ( uploaded, profsy_counter_register( uploaded_copy, PROFSY_COUNTER_TYPE_COUNTER ) );
+	profsy_counter_add( uploaded, 1024 );
+
+	profsy_swap_frame();
+
+	ASSERT_STR_EQ( "draw calls", profsy_get_counter_data( 0 )->name );
+	ASSERT_EQ( 3,    profsy_get_counter_data( 0 )->value );
+	ASSERT_EQ( 20,   profsy_get_counter_data( 1 )->value );
+	ASSERT_EQ( 1024, profsy_get_counter_data( uploaded )->value );
+	ASSERT_EQ( (profsy_counter_data*)0x0, profsy_get_counter_data( 3 ) );
+
+	// counters are reset each frame, gauges keep their value.
+	profsy_swap_frame();
+	ASSERT_EQ( 0,  profsy_get_counter_data( 0 )->value );
+	ASSERT_EQ( 20, profsy_get_counter_data( 1 )->value );
+	return 0;
+}
+
+static const int CONCURRENT_COUNTER_ADDS = 100000;
+
+static void add_concurrent_counters( int )
+{
+	for( int i = 0; i < CONCURRENT_COUNTER_ADDS; ++i )
+		counted_func( 1 );
+}
+
+TEST profsy_counters_added_concurrently()
+{
+	profsy_setup st( 8 );
+	ASSERT( st.mem != 0x0 );
+
+	// ... both os-threads register the same counters on first use and add to them at the same time ...
+	test_thread_func f = { add_concurrent_counters, 0 };
+	test_thread t1 = test_thread_start( &f );
+	test_thread t2 = test_thread_start( &f );
+	test_thread_join( t1 );
+	test_thread_join( t2 );
+	profsy_swap_frame();
+
+	ASSERT_EQ( 2u, profsy_num_counters() );
+	ASSERT_STR_EQ( "draw calls", profsy_get_counter_data( 0 )->name );
+	ASSERT_EQ( 2 * CONCURRENT_COUNTER_ADDS, profsy_get_counter_data( 0 )->value );
+	ASSERT_EQ( 10, profsy_get_counter_data( 1 )->value );
+	return 0;
+}
+
+TEST profsy_counters_in_trace()
+{
+	profsy_setup st( 8 );
+	ASSERT( st.mem != 0x0 );
+
+	profsy_trace_entry trace[64];
+	profsy_trace_begin( trace, (unsigned int)ARRAY_LENGTH(trace), 1 );
+	profsy_swap_frame();
+	counted_func( 7 );
+	profsy_swap_frame();
+	ASSERT_FALSE( profsy_is_tracing() );
+
+	ASSERT_EQ( PROFSY_TRACE_EVENT_ENTER,   trace[0].event );
+	ASSERT_EQ( PROFSY_TRACE_EVENT_COUNTER, trace[1].event ); ASSERT_EQ( 0u, trace[1].scope );
+	ASSERT_EQ( PROFSY_TRACE_EVENT_ARG,     trace[2].event ); ASSERT_EQ( 7u, trace[2].arg );
+	ASSERT_EQ( PROFSY_TRACE_EVENT_COUNTER, trace[3].event ); ASSERT_EQ( 1u, trace[3].scope );
+	ASSERT_EQ( PROFSY_TRACE_EVENT_ARG,     trace[4].event ); ASSERT_EQ( 70u, trace[4].arg );
+	ASSERT_EQ( PROFSY_TRACE_EVENT_LEAVE,   trace[5].event );
+
+	char json[4096];
+	ASSERT( dump_chrome_trace( trace, json, sizeof( json ) ) != 0x0 );
+	ASSERT( strstr( json, "\"ph\":\"C\", \"name\":\"draw calls\", \"args\":{ \"value\":7 }" ) != 0x0 );
+	ASSERT( strstr( json, "\"name\":\"entities\", \"args\":{ \"value\":70 }" ) != 0x0 );
+	return 0;
+}
+
+TEST trace_instant_and_args()
+{
+	profsy_setup st( 8 );
+	ASSERT( st.mem != 0x0 );
+
+	PROFSY_INSTANT( "not traced" );
+
+	profsy_trace_entry trace[64];
+	profsy_trace_begin( trace, (unsigned int)ARRAY_LENGTH(trace), 1 );
+	profsy_swap_frame();
+	{
+		PROFSY_SCOPE_ARG2( "batch", 128, -1 );
+		PROFSY_INSTANT( "level loaded" );
+	}
+	profsy_swap_frame();
+	ASSERT_FALSE( profsy_is_tracing() );
+
+	ASSERT_EQ( PROFSY_TRACE_EVENT_ENTER,   trace[0].event );
+	ASSERT_EQ( PROFSY_TRACE_EVENT_ENTER,   trace[1].event );
+	ASSERT_EQ( PROFSY_TRACE_EVENT_ARG,     trace[2].event ); ASSERT_EQ( 0u, trace[2].scope ); ASSERT_EQ( 128u, trace[2].arg );
+	ASSERT_EQ( PROFSY_TRACE_EVENT_ARG,     trace[3].event ); ASSERT_EQ( 1u, trace[3].scope ); ASSERT_EQ( (uint64_t)-1, trace[3].arg );
+	ASSERT_EQ( PROFSY_TRACE_EVENT_INSTANT, trace[4].event );
+	ASSERT_EQ( PROFSY_TRACE_EVENT_ARG,     trace[5].event ); ASSERT_EQ( PROFSY_TRACE_ARG_NAME, trace[5].scope );
+	ASSERT_EQ( PROFSY_TRACE_EVENT_LEAVE,   trace[6].event );
+	ASSERT_EQ( PROFSY_TRACE_EVENT_LEAVE,   trace[7].event );
+
+	char json[4096];
+	ASSERT( dump_chrome_trace( trace, json, sizeof( json ) ) != 0x0 );
+	char expect[128];
+	snprintf( expect, sizeof( expect ), "\"ph\":\"B\", \"name\":\"batch\", \"args\":{\"path_hash\":\"%016llx\", \"file\":", (unsigned long long)profsy_path_hash( "batch" ) );
+	ASSERT( strstr( json, expect ) != 0x0 );
+	ASSERT( strstr( json, "\"arg0\":128, \"arg1\":-1} }" ) != 0x0 );
+	ASSERT( strstr( json, "\"ph\":\"i\", \"s\":\"t\", \"name\":\"level loaded\", \"args\":{} }" ) != 0x0 );
+	ASSERT( strstr( json, "not traced" ) == 0x0 );
+	return 0;
+}
+
+static void trace_cheap_args_frame()
+{
+	PROFSY_SCOPE( "parent" );
+	PROFSY_SCOPE_ARG1( "cheap", 7 );
+}
+
+TEST trace_args_of_cheaper_scopes()
+{
+	profsy_setup st( 8 );
+	ASSERT( st.mem != 0x0 );
+
+	trace_cheap_args_frame();
+	profsy_swap_frame();
+	int cheap = profsy_find_scope( "parent.cheap" );
+	ASSERT_EQ( 0, profsy_set_scope_mode( cheap, PROFSY_SCOPE_MODE_COUNT_ONLY ) );
+
+	profsy_trace_entry trace[16];
+	memset( trace, 0x0, sizeof( trace ) );
+	profsy_trace_begin( trace, (unsigned int)ARRAY_LENGTH(trace), 1 );
+	profsy_swap_frame();
+	trace_cheap_args_frame();
+	{
+		// ... also when called directly, args after entering a count-only scope belong to no event ...
+		PROFSY_SCOPE( "parent" );
+		ASSERT_EQ( -1, profsy_scope_enter( "cheap", 0 ) );
+		int64_t arg = 8;
+		profsy_trace_args( &arg, 1 );
+	}
+	profsy_swap_frame();
+
+	ASSERT_EQ( 2u, profsy_get_scope_data( cheap )->calls );
+	ASSERT_EQ( PROFSY_TRACE_EVENT_ENTER, trace[0].event );
+	ASSERT_EQ( PROFSY_TRACE_EVENT_ENTER, trace[1].event );
+	ASSERT_EQ( PROFSY_TRACE_EVENT_LEAVE, trace[2].event );
+	ASSERT_EQ( PROFSY_TRACE_EVENT_ENTER, trace[3].event );
+	ASSERT_EQ( PROFSY_TRACE_EVENT_LEAVE, trace[4].event );
+	for( unsigned int i = 0; i < ARRAY_LENGTH( trace ); ++i )
+		ASSERT( trace[i].event != PROFSY_TRACE_EVENT_ARG );
+	return 0;
+}
+
+TEST trace_source_locations()
+{
+	profsy_setup st( 8 );
+	ASSERT( st.mem != 0x0 );
+
+	profsy_trace_entry trace[32];
+	profsy_trace_begin( trace, (unsigned int)ARRAY_LENGTH(trace), 1 );
+	profsy_swap_frame();
+	unsigned int line = __LINE__ + 2;
+	{
+		PROFSY_SCOPE( "located" );
+		profsy_scope_leave( profsy_scope_enter( "unlocated", 0 ), 0, 1 );
+	}
+	profsy_swap_frame();
+
+	// ... scopes registered from a call-site reference its static descriptor ...
+	const profsy_scope_data* data = profsy_get_scope_data( profsy_find_scope( "located" ) );
+	ASSERT( data->desc != 0x0 );
+	ASSERT_STR_EQ( "located", data->desc->name );
+	ASSERT( strstr( data->desc->file, "profsy_tests.cpp" ) != 0x0 );
+	ASSERT_STR_EQ( "trace_source_locations", data->desc->function );
+	ASSERT_EQ( line, data->desc->line );
+	ASSERT( profsy_get_scope_data( profsy_find_scope( "located.unlocated" ) )->desc == 0x0 );
+
+	char json[4096];
+	ASSERT( dump_chrome_trace( trace, json, sizeof( json ) ) != 0x0 );
+	char expect[64];
+	snprintf( expect, sizeof( expect ), "profsy_tests.cpp\", \"line\":%u", line );
+	ASSERT( strstr( json, expect ) != 0x0 );
+	ASSERT( strstr( json, "\"name\":\"unlocated\", \"args\":{\"path_hash\"" ) != 0x0 );
+	ASSERT( strstr( strstr( json, "\"name\":\"unlocated\"" ), "\"file\"" ) == 0x0 );
+	return 0;
+}
+
+static const uint32_t TEST_CATEGORY_RENDER  = 1u << 1;
+static const uint32_t TEST_CATEGORY_PHYSICS = 1u << 2;
+
+TEST trace_categories()
+{
+	profsy_setup st( 16 );
+	ASSERT( st.mem != 0x0 );
+
+	profsy_trace_entry trace[64];
+	profsy_trace_begin( trace, (unsigned int)ARRAY_LENGTH(trace), 1 );
+	profsy_set_trace_category_mask( TEST_CATEGORY_RENDER );
+	profsy_swap_frame();
+	{
+		PROFSY_SCOPE_CATEGORY( "render", TEST_CATEGORY_RENDER );
+		PROFSY_SCOPE_ARG1( "not traced", 1 );
+		PROFSY_SCOPE_CATEGORY( "physics", TEST_CATEGORY_PHYSICS );
+	}
+
+	// ... disabled categories are not recorded at all ...
+	profsy_set_category_mask( PROFSY_CATEGORY_ALL & ~TEST_CATEGORY_RENDER );
+	{
+		PROFSY_SCOPE_CATEGORY( "render_disabled", TEST_CATEGORY_RENDER );
+	}
+	profsy_set_category_mask( PROFSY_CATEGORY_ALL );
+	profsy_swap_frame();
+
+	ASSERT_EQ( -1, profsy_find_scope( "render_disabled" ) );
+	int physics = profsy_find_scope( "render.not traced.physics" );
+	ASSERT_EQ( TEST_CATEGORY_PHYSICS, profsy_get_scope_data( physics )->category );
+	ASSERT_EQ( 1u, profsy_get_scope_data( physics )->calls );
+	ASSERT_EQ( PROFSY_CATEGORY_DEFAULT, profsy_get_scope_data( profsy_find_scope( "render.not traced" ) )->category );
+
+	// ... only render enter/leave and the frame-events are in the trace, args of filtered scopes are skipped ...
+	ASSERT_EQ( PROFSY_TRACE_EVENT_ENTER, trace[0].event );
+	ASSERT_EQ( PROFSY_TRACE_EVENT_ENTER, trace[1].event ); ASSERT_EQ( (uint32_t)profsy_find_scope( "render" ), trace[1].scope );
+	ASSERT_EQ( PROFSY_TRACE_EVENT_LEAVE, trace[2].event ); ASSERT_EQ( (uint32_t)profsy_find_scope( "render" ), trace[2].scope );
+	ASSERT_EQ( PROFSY_TRACE_EVENT_LEAVE, trace[3].event ); ASSERT_EQ( 0u, trace[3].scope );
+	return 0;
+}
+
+struct dump_output
+{
+	uint8_t      data[4096];
+	size_t       used;
+	unsigned int calls;
+};
+
+static void dump_output_callback( const uint8_t* data, size_t byte_count, void* userdata )
+{
+	dump_output* out = (dump_output*)userdata;
+	if( out->used + byte_count < sizeof( out->data ) )
+	{
+		memcpy( out->data + out->used, data, byte_count );
+		out->used += byte_count;
+	}
+	out->data[out->used] = '\0';
+	++out->calls;
+}
+
+TEST trace_folded_stacks()
+{
+	profsy_setup st( 16 );
+	ASSERT( st.mem != 0x0 );
+
+	int render = profsy_create_thread_ctx( "render" );
+
+	profsy_trace_entry trace[32];
+	profsy_trace_begin( trace, (unsigned int)ARRAY_LENGTH(trace), 1 );
+	profsy_swap_frame();
+	int a = profsy_scope_enter( "a", 100 );
+	profsy_scope_leave_thread( render, profsy_scope_enter_thread( render, "draw", 0 ), 0, 5 );
+	profsy_scope_leave( profsy_scope_enter( "b", 110 ), 110, 130 );
+	profsy_scope_leave( a, 100, 150 );
+	profsy_swap_frame();
+
+	// ... one line per call with self-time, based at the thread-name ...
+	char text[1024];
+	ASSERT( dump_trace( trace, PROFSY_UTIL_DUMP_FORMAT_TEXT, text, sizeof( text ) ) != 0x0 );
+	ASSERT( strstr( text, "main;a;b 20\nmain;a 30\n" ) != 0x0 );
+	ASSERT( strstr( text, "render;draw 5\n" ) != 0x0 );
+	ASSERT( strstr( text, "render;draw 5\n" ) > strstr( text, "main;a 30\n" ) );
+
+	// ... the tree gives the same stacks from the published data ...
+	FILE* f = tmpfile();
+	ASSERT( f != 0x0 );
+	profsy_util_dump_tree_to_stream( f );
+	ASSERT( read_dump( f, text, sizeof( text ) ) != 0x0 );
+	ASSERT( strstr( text, "main;a;b 20\nmain;a 30\n" ) != 0x0 );
+	ASSERT( strstr( text, "render;draw 5\n" ) != 0x0 );
+	ASSERT( strstr( text, "render 0" ) == 0x0 );
+
+	// ... the tree can be dumped line by line through a callback as well ...
+	dump_output out;
+	out.used = 0; out.calls = 0;
+	profsy_util_dump_tree( PROFSY_UTIL_DUMP_MODE_LINE, dump_output_callback, &out );
+	ASSERT_STR_EQ( text, (const char*)out.data );
+	ASSERT( out.calls >= 3u );
+	return 0;
+}
+
+TEST trace_exporters()
+{
+	profsy_setup st( 16 );
+	ASSERT( st.mem != 0x0 );
+
+	profsy_trace_entry trace[32];
+	profsy_trace_begin( trace, (unsigned int)ARRAY_LENGTH(trace), 1 );
+	profsy_swap_frame();
+	int a = profsy_scope_enter( "a", 100 );
+	profsy_scope_leave( profsy_scope_enter( "b", 110 ), 110, 130 );
+	profsy_scope_leave( a, 100, 150 );
+	profsy_swap_frame();
+
+	// ... speedscope has one evented profile per thread with a frame for each scope used in the trace ...
+	dump_output out;
+	out.used = 0; out.calls = 0;
+	profsy_util_dump( trace, PROFSY_UTIL_DUMP_FORMAT_SPEEDSCOPE, PROFSY_UTIL_DUMP_MODE_CHUNK, dump_output_callback, &out );
+	ASSERT_EQ( 1u, out.calls );
+	ASSERT( strstr( (const char*)out.data, "\"frames\":[{\"name\":\"a\"},\n{\"name\":\"b\"}] }" ) != 0x0 );
+	ASSERT( strstr( (const char*)out.data, "\"type\":\"evented\", \"name\":\"main\", \"unit\":\"nanoseconds\", \"startValue\":100, \"endValue\":150" ) != 0x0 );
+	ASSERT( strstr( (const char*)out.data, "{ \"type\":\"O\", \"frame\":1, \"at\":110 }" ) != 0x0 );
+
+	// ... perfetto is a stream of length-delimited TracePackets in field 1 of Trace ...
+	out.used = 0; out.calls = 0;
+	profsy_util_dump( trace, PROFSY_UTIL_DUMP_FORMAT_PERFETTO, PROFSY_UTIL_DUMP_MODE_LINE, dump_output_callback, &out );
+	unsigned int packets = 0;
+	size_t pos = 0;
+	while( pos < out.used )
+	{
+		ASSERT_EQ( 0x0A, out.data[pos] );
+		size_t len = ( out.data[pos + 1] & 0x7Fu ) | ( ( out.data[pos + 2] & 0x7Fu ) << 7 ) | ( ( out.data[pos + 3] & 0x7Fu ) << 14 ) | ( (size_t)out.data[pos + 4] << 21 );
+		pos += 5 + len;
+		++packets;
+	}
+	ASSERT_EQ( out.used, pos );
+	ASSERT_EQ( 5u, packets ); // thread-track + enter/leave of a and b.
+	ASSERT_EQ( packets, out.calls );
+
+	// ... line-mode calls back once per line ...
+	out.used = 0; out.calls = 0;
+	profsy_util_dump( trace, PROFSY_UTIL_DUMP_FORMAT_TEXT, PROFSY_UTIL_DUMP_MODE_LINE, dump_output_callback, &out );
+	ASSERT_EQ( 3u, out.calls ); // main;a;b, main;a and main
+	return 0;
+}
+
+TEST trace_speedscope_overflow_frames()
+{
+	profsy_setup st( 4 );
+	ASSERT( st.mem != 0x0 );
+
+	int worker = profsy_create_thread_ctx( "worker" );
+	profsy_set_thread_ctx( worker );
+
+	profsy_trace_entry trace[32];
+	profsy_trace_begin( trace, (unsigned int)ARRAY_LENGTH(trace), 1 );
+	profsy_swap_frame();
+	{
+		PROFSY_SCOPE( "a" );
+		PROFSY_SCOPE( "b" );
+		PROFSY_SCOPE( "c" ); // ... overflows with an id after all entries and the overflow-names of main ...
+	}
+	profsy_set_thread_ctx( 0 );
+	profsy_swap_frame();
+
+	// ... only the three scopes used is written as frames ...
+	dump_output out;
+	out.used = 0; out.calls = 0;
+	profsy_util_dump( trace, PROFSY_UTIL_DUMP_FORMAT_SPEEDSCOPE, PROFSY_UTIL_DUMP_MODE_CHUNK, dump_output_callback, &out );
+	ASSERT( strstr( (const char*)out.data, "\"frames\":[{\"name\":\"a\"" ) != 0x0 );
+	ASSERT( strstr( (const char*)out.data, "{\"name\":\"c\"}] }" ) != 0x0 );
+	ASSERT( strstr( (const char*)out.data, "{ \"type\":\"O\", \"frame\":2, " ) != 0x0 );
+	return 0;
+}
+
+TEST trace_wide_scope_ids()
+{
+	profsy_setup st( 16 + WIDE_TREE_FANOUT * ( WIDE_TREE_FANOUT + 1 ) );
+	ASSERT( st.mem != 0x0 );
+	register_wide_tree();
+	ASSERT( profsy_num_active_scopes() > 0xFFFF );
+
+	profsy_trace_entry trace[16];
+	profsy_trace_begin( trace, (unsigned int)ARRAY_LENGTH(trace), 1 );
+	profsy_swap_frame();
+	{
+		PROFSY_SCOPE( wide_tree_names[WIDE_TREE_FANOUT - 1] );
+		PROFSY_SCOPE( wide_tree_names[WIDE_TREE_FANOUT - 1] );
+	}
+	profsy_swap_frame();
+
+	int last = profsy_find_scope( "s255.s255" );
+	ASSERT( last > 0xFFFF );
+	ASSERT_EQ( PROFSY_TRACE_EVENT_ENTER, trace[2].event ); ASSERT_EQ( (uint32_t)last, trace[2].scope );
+	ASSERT_EQ( PROFSY_TRACE_EVENT_LEAVE, trace[3].event ); ASSERT_EQ( (uint32_t)last, trace[3].scope );
+	return 0;
+}
+
+static void trace_filter_frame()
+{
+	int outer = profsy_scope_enter( "outer", 0 );
+	profsy_scope_leave( profsy_scope_enter( "short", 1 ), 1, 3 );
+	int lng = profsy_scope_enter( "long", 4 );
+	profsy_scope_leave( profsy_scope_enter( "deep", 5 ), 5, 30 );
+	profsy_scope_leave( lng, 4, 20 );
+	int excluded = profsy_scope_enter( "excluded", 21 );
+	profsy_scope_leave( profsy_scope_enter( "child", 22 ), 22, 40 );
+	profsy_scope_leave( excluded, 21, 41 );
+	int marked = profsy_scope_enter( "marked", 42 );
+	profsy_instant( "mark", 43 );
+	profsy_scope_leave( marked, 42, 44 );
+	profsy_scope_leave( outer, 0, 50 );
+}
+
+TEST trace_filters()
+{
+	profsy_setup st( 16 );
+	ASSERT( st.mem != 0x0 );
+
+	profsy_trace_entry trace[32];
+	profsy_set_trace_max_depth( 2 );
+	profsy_set_trace_min_duration( 10 );
+	ASSERT( profsy_trace_filter_scope( profsy_path_hash( "outer.excluded" ), false ) );
+	profsy_trace_begin( trace, (unsigned int)ARRAY_LENGTH(trace), 1 );
+	profsy_swap_frame();
+	trace_filter_frame();
+	profsy_swap_frame();
+
+	// ... short scopes are dropped unless something was traced in them, deep and excluded scopes are not traced ...
+	ASSERT_EQ( PROFSY_TRACE_EVENT_ENTER,   trace[0].event ); ASSERT_EQ( 0u, trace[0].scope );
+	ASSERT_EQ( PROFSY_TRACE_EVENT_ENTER,   trace[1].event ); ASSERT_EQ( (uint32_t)profsy_find_scope( "outer" ), trace[1].scope );       ASSERT_EQ( 0u,  trace[1].ts );
+	ASSERT_EQ( PROFSY_TRACE_EVENT_ENTER,   trace[2].event ); ASSERT_EQ( (uint32_t)profsy_find_scope( "outer.long" ), trace[2].scope );  ASSERT_EQ( 4u,  trace[2].ts );
+	ASSERT_EQ( PROFSY_TRACE_EVENT_LEAVE,   trace[3].event ); ASSERT_EQ( (uint32_t)profsy_find_scope( "outer.long" ), trace[3].scope );  ASSERT_EQ( 20u, trace[3].ts );
+	ASSERT_EQ( PROFSY_TRACE_EVENT_ENTER,   trace[4].event ); ASSERT_EQ( (uint32_t)profsy_find_scope( "outer.marked" ), trace[4].scope ); ASSERT_EQ( 42u, trace[4].ts );
+	ASSERT_EQ( PROFSY_TRACE_EVENT_INSTANT, trace[5].event );
+	ASSERT_EQ( PROFSY_TRACE_EVENT_ARG,     trace[6].event );
+	ASSERT_EQ( PROFSY_TRACE_EVENT_LEAVE,   trace[7].event ); ASSERT_EQ( (uint32_t)profsy_find_scope( "outer.marked" ), trace[7].scope );
+	ASSERT_EQ( PROFSY_TRACE_EVENT_LEAVE,   trace[8].event ); ASSERT_EQ( (uint32_t)profsy_find_scope( "outer" ), trace[8].scope );       ASSERT_EQ( 50u, trace[8].ts );
+	ASSERT_EQ( PROFSY_TRACE_EVENT_LEAVE,   trace[9].event ); ASSERT_EQ( 0u, trace[9].scope );
+
+	// ... filtered scopes still record time ...
+	ASSERT_EQ( 1u, profsy_get_scope_data( profsy_find_scope( "outer.excluded.child" ) )->calls );
+
+	// ... with an include-filter only that subtree is traced ...
+	profsy_trace_clear_scope_filters();
+	profsy_set_trace_min_duration( 0 );
+	profsy_set_trace_max_depth( 0 );
+	ASSERT( profsy_trace_filter_scope( profsy_path_hash( "outer.excluded" ), true ) );
+	profsy_trace_begin( trace, (unsigned int)ARRAY_LENGTH(trace), 1 );
+	profsy_swap_frame();
+	trace_filter_frame();
+	profsy_swap_frame();
+
+	ASSERT_EQ( PROFSY_TRACE_EVENT_ENTER,   trace[1].event ); ASSERT_EQ( (uint32_t)profsy_find_scope( "outer.excluded" ), trace[1].scope );
+	ASSERT_EQ( PROFSY_TRACE_EVENT_ENTER,   trace[2].event ); ASSERT_EQ( (uint32_t)profsy_find_scope( "outer.excluded.child" ), trace[2].scope );
+	ASSERT_EQ( PROFSY_TRACE_EVENT_LEAVE,   trace[3].event );
+	ASSERT_EQ( PROFSY_TRACE_EVENT_LEAVE,   trace[4].event ); ASSERT_EQ( (uint32_t)profsy_find_scope( "outer.excluded" ), trace[4].scope );
+	ASSERT_EQ( PROFSY_TRACE_EVENT_INSTANT, trace[5].event );
+	return 0;
+}
+
+static volatile bool burn_cpu_stop;
+
+static void burn_cpu( int )
+{
+	volatile uint64_t sum = 0;
+	while( !burn_cpu_stop )
+		sum += 1;
+}
+
+TEST trace_dropped_leave_has_no_args()
+{
+	profsy_setup st( 8 );
+	ASSERT( st.mem != 0x0 );
+
+	int scope = profsy_scope_enter( "preempted", 0 );
+	profsy_scope_leave( scope, 0, 1 );
+	ASSERT_EQ( 0, profsy_set_scope_flags( scope, PROFSY_SCOPE_FLAG_SCHED_INFO ) );
+
+	profsy_trace_entry trace[32];
+	profsy_set_trace_min_duration( 10 );
+	profsy_trace_begin( trace, (unsigned int)ARRAY_LENGTH(trace), 1 );
+	profsy_swap_frame();
+
+	// ... compete for the cpu to get the scope preempted, its leave is dropped as to short and so should its args be ...
+	burn_cpu_stop = false;
+	test_thread_func f = { burn_cpu, 0 };
+	test_thread t = test_thread_start( &f );
+	profsy_scope_enter( "preempted", 0 );
+	volatile uint64_t sum = 0;
+	for( clock_t start = clock(); clock() - start < CLOCKS_PER_SEC / 10; )
+		sum += 1;
+	profsy_scope_leave( scope, 0, 1 );
+	burn_cpu_stop = true;
+	test_thread_join( t );
+	profsy_set_trace_min_duration( 0 );
+	profsy_swap_frame();
+
+	for( unsigned int i = 0; trace[i].event != PROFSY_TRACE_EVENT_END; ++i )
+		ASSERT( trace[i].event != PROFSY_TRACE_EVENT_ARG );
+	return 0;
+}
+
+TEST trace_flow()
+{
+	profsy_setup st( 8 );
+	ASSERT( st.mem != 0x0 );
+
+	int worker = profsy_create_thread_ctx( "worker" );
+
+	profsy_trace_entry trace[64];
+	profsy_trace_begin( trace, (unsigned int)ARRAY_LENGTH(trace), 1 );
+	profsy_swap_frame();
+	{
+		PROFSY_SCOPE( "schedule" );
+		PROFSY_FLOW_BEGIN( "job", 0x100000001ULL );
+	}
+
+	profsy_set_thread_ctx( worker );
+	{
+		PROFSY_SCOPE( "execute" );
+		PROFSY_FLOW_END( "job", 0x100000001ULL );
+	}
+	profsy_set_thread_ctx( 0 );
+	profsy_swap_frame();
+
+	ASSERT_EQ( PROFSY_TRACE_EVENT_ENTER,      trace[1].event ); ASSERT_EQ( 0u, trace[1].thread );
+	ASSERT_EQ( PROFSY_TRACE_EVENT_FLOW_BEGIN, trace[2].event ); ASSERT_EQ( 0u, trace[2].thread );
+	ASSERT_EQ( PROFSY_TRACE_EVENT_ARG,        trace[3].event ); ASSERT_EQ( 0x100000001ULL, trace[3].arg );
+	ASSERT_EQ( PROFSY_TRACE_EVENT_ENTER,      trace[6].event ); ASSERT_EQ( (uint16_t)worker, trace[6].thread );
+	ASSERT_EQ( PROFSY_TRACE_EVENT_FLOW_END,   trace[7].event ); ASSERT_EQ( (uint16_t)worker, trace[7].thread );
+
+	char json[4096];
+	ASSERT( dump_chrome_trace( trace, json, sizeof( json ) ) != 0x0 );
+	ASSERT( strstr( json, "\"tid\":\"main\", \"ts\":" ) != 0x0 );
+	ASSERT( strstr( json, "\"ph\":\"s\", \"id\":4294967297, \"name\":\"job\"" ) != 0x0 );
+	ASSERT( strstr( json, "\"tid\":\"worker\", \"ts\":" ) != 0x0 );
+	ASSERT( strstr( json, "\"ph\":\"f\", \"id\":4294967297, \"name\":\"job\"" ) != 0x0 );
+	return 0;
+}
+
+TEST profsy_async_spans()
+{
+	profsy_setup st( 8 );
+	ASSERT( st.mem != 0x0 );
+
+	int worker = profsy_create_thread_ctx( "worker" );
+
+	profsy_trace_entry trace[64];
+	profsy_trace_begin( trace, (unsigned int)ARRAY_LENGTH(trace), 1 );
+	profsy_swap_frame();
+
+	profsy_span_t req1 = profsy_span_begin( "request", 1000 );
+	profsy_span_t req2 = profsy_span_begin( "request", 2000 );
+	ASSERT( req1 != 0 );
+	ASSERT( req1 != req2 );
+
+	// ... spans can be ended on another thread than they began on ...
+	profsy_set_thread_ctx( worker );
+	profsy_span_end( req2, 2500 );
+	profsy_span_end( req1, 4000 );
+	profsy_span_end( req1, 9000 ); // ending twice is a no-op.
+	profsy_set_thread_ctx( 0 );
+
+	// ... slot is reused but old handle stays invalid ...
+	profsy_span_t req3 = profsy_span_begin( "request", 5000 );
+	ASSERT( req3 != req1 && req3 != req2 );
+	profsy_span_end( req1, 9000 );
+	profsy_span_end( req3, 5100 );
+
+	// ... spans are accumulated by the content of the name, not by pointer ...
+	static char request_copy[] = "request";
+	profsy_span_end( profsy_span_begin( request_copy, 6000 ), 6000 );
+
+	profsy_swap_frame();
+
+	const profsy_span_data* spans[4];
+	ASSERT_EQ( 1u, profsy_get_span_data( spans, (unsigned int)ARRAY_LENGTH( spans ) ) );
+	ASSERT_STR_EQ( "request", spans[0]->name );
+	ASSERT_EQ( 4u,    spans[0]->calls );
+	ASSERT_EQ( 3600u, spans[0]->time );
+	ASSERT_EQ( 3000u, spans[0]->max_time );
+
+	char json[4096];
+	ASSERT( dump_chrome_trace( trace, json, sizeof( json ) ) != 0x0 );
+	char expect[128];
+	snprintf( expect, sizeof( expect ), "\"ph\":\"b\", \"id\":%llu, \"name\":\"request\"", (unsigned long long)req1 );
+	ASSERT( strstr( json, expect ) != 0x0 );
+	snprintf( expect, sizeof( expect ), "\"tid\":\"worker\", \"ts\":4, \"ph\":\"e\", \"id\":%llu", (unsigned long long)req1 );
+	ASSERT( strstr( json, expect ) != 0x0 );
+
+	// ... stats are per frame ...
+	profsy_swap_frame();
+	ASSERT_EQ( 0u, spans[0]->calls );
+	return 0;
+}
+
+static const unsigned int CONCURRENT_SPANS = 128;
+static profsy_span_t concurrent_spans[CONCURRENT_SPANS];
+
+static void end_concurrent_spans( int thread_ctx )
+{
+	profsy_set_thread_ctx( thread_ctx );
+	for( unsigned int i = 0; i < CONCURRENT_SPANS; ++i )
+		profsy_span_end( concurrent_spans[i], 2 );
+}
+
+TEST profsy_async_spans_end_concurrently()
+{
+	profsy_setup st( 8 );
+	ASSERT( st.mem != 0x0 );
+
+	int worker = profsy_create_thread_ctx( "worker" );
+
+	static profsy_trace_entry trace[4096];
+	memset( trace, 0x0, sizeof( trace ) );
+	profsy_trace_begin( trace, (unsigned int)ARRAY_LENGTH(trace), 1 );
+	profsy_swap_frame();
+
+	for( unsigned int i = 0; i < CONCURRENT_SPANS; ++i )
+		concurrent_spans[i] = profsy_span_begin( "request", 1 );
+
+	// ... spans are ended on another os-thread while this one keeps tracing scopes ...
+	test_thread_func f = { end_concurrent_spans, worker };
+	test_thread t = test_thread_start( &f );
+	for( unsigned int i = 0; i < CONCURRENT_SPANS; ++i )
+		profsy_scope_leave( profsy_scope_enter( "work", 1 ), 1, 2 );
+	test_thread_join( t );
+	profsy_swap_frame();
+
+	// ... enter of "main", spans begun, scopes, spans ended and "main" swapped, no entry lost or overwritten ...
+	unsigned int expected = 1 + CONCURRENT_SPANS * 3 + CONCURRENT_SPANS * 2 + CONCURRENT_SPANS * 3 + 2;
+	ASSERT_EQ( PROFSY_TRACE_EVENT_END, trace[expected].event );
+
+	unsigned int span_ends = 0;
+	for( unsigned int i = 0; i < expected; ++i )
+	{
+		if( trace[i].event != PROFSY_TRACE_EVENT_SPAN_END )
+			continue;
+		++span_ends;
+		ASSERT_EQ( PROFSY_TRACE_EVENT_ARG, trace[i + 1].event ); ASSERT_EQ( 0u, trace[i + 1].scope );
+		ASSERT_EQ( PROFSY_TRACE_EVENT_ARG, trace[i + 2].event ); ASSERT_EQ( PROFSY_TRACE_ARG_NAME, trace[i + 2].scope );
+		ASSERT_EQ( (uint16_t)worker, trace[i + 1].thread );
+	}
+	ASSERT_EQ( CONCURRENT_SPANS, span_ends );
+	return 0;
+}
+
+static const unsigned int CONCURRENT_SCOPE_ARGS = 2048;
+static volatile long concurrent_scope_args_started;
+
+static void enter_scopes_with_args( int thread_ctx )
+{
+	profsy_set_thread_ctx( thread_ctx );
+
+	// ... wait for the other os-thread to get the threads to trace at the same time ...
+	test_atomic_inc( &concurrent_scope_args_started );
+	while( concurrent_scope_args_started < 2 ) {}
+
+	for( unsigned int i = 0; i < CONCURRENT_SCOPE_ARGS; ++i )
+	{
+		PROFSY_SCOPE_ARG2( "batch", thread_ctx, i );
+	}
+}
+
+TEST trace_scope_args_concurrently()
+{
+	profsy_setup st( 16 );
+	ASSERT( st.mem != 0x0 );
+
+	int w1 = profsy_create_thread_ctx( "worker1" );
+	int w2 = profsy_create_thread_ctx( "worker2" );
+
+	static profsy_trace_entry trace[2 * CONCURRENT_SCOPE_ARGS * 4 + 64];
+	memset( trace, 0x0, sizeof( trace ) );
+	profsy_trace_begin( trace, (unsigned int)ARRAY_LENGTH(trace), 1 );
+	profsy_swap_frame();
+
+	// ... both os-threads trace scopes with arguments at the same time ...
+	test_thread_func f1 = { enter_scopes_with_args, w1 };
+	test_thread_func f2 = { enter_scopes_with_args, w2 };
+	test_thread t1 = test_thread_start( &f1 );
+	test_thread t2 = test_thread_start( &f2 );
+	test_thread_join( t1 );
+	test_thread_join( t2 );
+	profsy_swap_frame();
+
+	// ... every enter is directly followed by its own arguments ...
+	unsigned int enters = 0;
+	for( unsigned int i = 0; trace[i].event != PROFSY_TRACE_EVENT_END; ++i )
+	{
+		ASSERT( trace[i].event != PROFSY_TRACE_EVENT_OVERFLOW );
+		if( trace[i].event != PROFSY_TRACE_EVENT_ENTER || trace[i].thread == 0 )
+			continue;
+		++enters;
+		ASSERT_EQ( PROFSY_TRACE_EVENT_ARG, trace[i + 1].event ); ASSERT_EQ( 0u, trace[i + 1].scope );
+		ASSERT_EQ( PROFSY_TRACE_EVENT_ARG, trace[i + 2].event ); ASSERT_EQ( 1u, trace[i + 2].scope );
+		ASSERT_EQ( trace[i].thread, trace[i + 1].thread );
+		ASSERT_EQ( trace[i].thread, trace[i + 2].thread );
+		ASSERT_EQ( (uint64_t)trace[i].thread, trace[i + 1].arg );
+	}
+	ASSERT_EQ( 2 * CONCURRENT_SCOPE_ARGS, enters );
 	return 0;
 }
 
@@ -477,15 +2086,54 @@ GREATEST_SUITE( profsy )
 	RUN_TEST( profsy_simple_scope_alloc );
 	RUN_TEST( profsy_deep_hierarchy );
 	RUN_TEST( profsy_two_paths );
+	RUN_TEST( profsy_dynamic_scope_names );
+	RUN_TEST( profsy_hierarchy_is_kept_in_order );
+	RUN_TEST( profsy_name_data_aggregates_paths );
 	RUN_TEST( profsy_find_scope_non_exist );
+	RUN_TEST( profsy_find_scope_all_threads );
+	RUN_TEST( profsy_thread_group_merge );
+	RUN_TEST( profsy_thread_group_concurrent_register );
+	RUN_TEST( profsy_frame_domains );
+	RUN_TEST( profsy_perf_counters );
+	RUN_TEST( profsy_scope_sched_info );
+	RUN_TEST( profsy_sampling );
+	RUN_TEST( profsy_overhead_calibration );
+	RUN_TEST( profsy_overhead_name_self_time );
+	RUN_TEST( profsy_overhead_budget );
+	RUN_TEST( profsy_loop_scopes );
+	RUN_TEST( profsy_collapse_recursion );
+	RUN_TEST( profsy_stable_path_hashes );
+	RUN_TEST( profsy_fiber_suspended_time );
 	RUN_TEST( profsy_out_of_resources_is_tracked );
+	RUN_TEST( profsy_overflow_names_are_tracked );
+	RUN_TEST( profsy_overflow_names_under_nested_parent );
+	RUN_TEST( profsy_overflow_under_nested_parents );
 	RUN_TEST( profsy_multi_overflow );
+	RUN_TEST( profsy_overflow_is_listed_once );
+	RUN_TEST( profsy_wide_sub_scope_count );
+	RUN_TEST( profsy_counters );
+	RUN_TEST( profsy_counters_added_concurrently );
 }
 
 GREATEST_SUITE( trace )
 {
 	RUN_TEST( trace_simple );
 	RUN_TEST( trace_overflow );
+	RUN_TEST( profsy_counters_in_trace );
+	RUN_TEST( trace_instant_and_args );
+	RUN_TEST( trace_args_of_cheaper_scopes );
+	RUN_TEST( trace_source_locations );
+	RUN_TEST( trace_categories );
+	RUN_TEST( trace_filters );
+	RUN_TEST( trace_dropped_leave_has_no_args );
+	RUN_TEST( trace_wide_scope_ids );
+	RUN_TEST( trace_folded_stacks );
+	RUN_TEST( trace_exporters );
+	RUN_TEST( trace_speedscope_overflow_frames );
+	RUN_TEST( trace_flow );
+	RUN_TEST( profsy_async_spans );
+	RUN_TEST( profsy_async_spans_end_concurrently );
+	RUN_TEST( trace_scope_args_concurrently );
 }
 
 GREATEST_MAIN_DEFS();